@@ -0,0 +1,21 @@
+/******************************************************************************
+*  File name:		bootloader_key.c
+*  Version:         1.0
+*******************************************************************************/
+
+/* Public key of the application images. This copy has no key, make your own signing key and
+ * replace this file with the one made from it before defining BL_ENABLE_APP_SIGNATURE_CHECK :
+ *   openssl genrsa -traditional -out <key.pem> 2048
+ *   python Host.py --export-key <key.pem> > bootloader_key.c
+ * Keep the key file out of the repository, only its public part goes in this file */
+
+#include <stdint.h>
+#include "bootloader.h"
+#include "bootloader_signature.h"
+
+#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+#error "bootloader_key.c has no public key, make it with : python Host.py --export-key <key.pem> > bootloader_key.c"
+#endif
+
+/* A zero modulus never verifies a signature */
+const BL_RSA_Public_Key BL_App_Public_Key = {0};
@@ -0,0 +1,197 @@
+/******************************************************************************
+*  File name:		bootloader_sha256.c
+*  Date:				Oct 16, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* SHA-256 (FIPS 180-4) for the Cortex-M3 : the rounds are unrolled by 8 so the eight working
+ * variables never move between registers, the rotations are single ROR instructions, the
+ * big endian words are loaded with REV and the message schedule is kept in 16 words */
+
+/*******************************************************************************
+*                        		Inclusions                                   		   *
+*******************************************************************************/
+#include <stdint.h>
+#include <string.h>
+#include "main.h"
+#include "bootloader_signature.h"
+
+/*******************************************************************************
+*                        		Definitions                                   		 *
+*******************************************************************************/
+#define BL_SHA256_ROTR(x,n)									__ROR((x),(n))
+#define BL_SHA256_SUM0(x)										(BL_SHA256_ROTR(x,2) ^ BL_SHA256_ROTR(x,13) ^ BL_SHA256_ROTR(x,22))
+#define BL_SHA256_SUM1(x)										(BL_SHA256_ROTR(x,6) ^ BL_SHA256_ROTR(x,11) ^ BL_SHA256_ROTR(x,25))
+#define BL_SHA256_SIG0(x)										(BL_SHA256_ROTR(x,7) ^ BL_SHA256_ROTR(x,18) ^ ((x) >> 3))
+#define BL_SHA256_SIG1(x)										(BL_SHA256_ROTR(x,17) ^ BL_SHA256_ROTR(x,19) ^ ((x) >> 10))
+#define BL_SHA256_CH(x,y,z)									((z) ^ ((x) & ((y) ^ (z))))
+#define BL_SHA256_MAJ(x,y,z)								(((x) & (y)) | ((z) & ((x) | (y))))
+
+/* Message word of rounds 0 to 15 and the schedule of rounds 16 to 63 */
+#define BL_SHA256_LOAD(i)										(W[(i)] = __REV(__UNALIGNED_UINT32_READ(Block + (4 * (i)))))
+#define BL_SHA256_SCHEDULE(i)								(W[(i) & 15] += BL_SHA256_SIG1(W[((i) - 2) & 15]) + W[((i) - 7) & 15] \
+																							+ BL_SHA256_SIG0(W[((i) - 15) & 15]))
+
+/* One round, the caller rotates the names instead of moving the variables */
+#define BL_SHA256_ROUND(a,b,c,d,e,f,g,h,i,Wi)	\
+	T1 = (h) + BL_SHA256_SUM1(e) + BL_SHA256_CH(e,f,g) + BL_SHA256_K[(i)] + (Wi);	\
+	(d) += T1;	\
+	(h) = T1 + BL_SHA256_SUM0(a) + BL_SHA256_MAJ(a,b,c)
+
+#define BL_SHA256_LENGTH_SIZE								8		/* bit length at the end of the padding */
+#define BL_SHA256_PAD_BYTE									0x80
+
+/*******************************************************************************
+*                      Private Functions                               		     *
+*******************************************************************************/
+/*******************************************************************************
+* Function Name:		BL_SHA256_Transform
+* Description:			Hash one 64 byte block into the state
+* Parameters (in):  State and the block (any alignment)
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_SHA256_Transform(uint32_t *State, const uint8_t *Block);
+
+/*******************************************************************************
+*                           Global Variables                                  *
+*******************************************************************************/
+static const uint32_t BL_SHA256_K[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static const uint32_t BL_SHA256_Initial_State[BL_SHA256_STATE_WORDS] =
+{
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+/*******************************************************************************
+*                      Functions Definitions                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		BL_SHA256_Init
+********************************************************************************/
+void BL_SHA256_Init(BL_SHA256_Context *Context)
+{
+	memcpy(Context->State,BL_SHA256_Initial_State,sizeof(Context->State));
+	Context->Total_Len = 0;
+}
+
+/*******************************************************************************
+* Function Name:		BL_SHA256_Update
+********************************************************************************/
+void BL_SHA256_Update(BL_SHA256_Context *Context, const uint8_t *Data, uint32_t Data_Len)
+{
+	uint32_t Block_Len = Context->Total_Len % BL_SHA256_BLOCK_SIZE;
+	uint32_t Copy_Len = 0;
+
+	Context->Total_Len += Data_Len;
+	/* Fill the block left by the last update first */
+	if(0 != Block_Len)
+	{
+		Copy_Len = BL_SHA256_BLOCK_SIZE - Block_Len;
+		if(Copy_Len > Data_Len)
+		{
+			Copy_Len = Data_Len;
+		}
+		memcpy(Context->Block + Block_Len,Data,Copy_Len);
+		Data += Copy_Len;
+		Data_Len -= Copy_Len;
+		if((Block_Len + Copy_Len) < BL_SHA256_BLOCK_SIZE)
+		{
+			return;
+		}
+		BL_SHA256_Transform(Context->State,Context->Block);
+	}
+	/* The image is hashed straight from the flash, no copy */
+	for( ; Data_Len >= BL_SHA256_BLOCK_SIZE ; Data += BL_SHA256_BLOCK_SIZE, Data_Len -= BL_SHA256_BLOCK_SIZE)
+	{
+		BL_SHA256_Transform(Context->State,Data);
+	}
+	memcpy(Context->Block,Data,Data_Len);
+}
+
+/*******************************************************************************
+* Function Name:		BL_SHA256_Final
+********************************************************************************/
+void BL_SHA256_Final(BL_SHA256_Context *Context, uint8_t *Digest)
+{
+	uint32_t Block_Len = Context->Total_Len % BL_SHA256_BLOCK_SIZE;
+	uint32_t Bit_Len_High = Context->Total_Len >> 29;
+	uint32_t Bit_Len_Low = Context->Total_Len << 3;
+	uint8_t Index = 0;
+
+	Context->Block[Block_Len++] = BL_SHA256_PAD_BYTE;
+	if(Block_Len > (BL_SHA256_BLOCK_SIZE - BL_SHA256_LENGTH_SIZE))
+	{
+		memset(Context->Block + Block_Len,0,BL_SHA256_BLOCK_SIZE - Block_Len);
+		BL_SHA256_Transform(Context->State,Context->Block);
+		Block_Len = 0;
+	}
+	memset(Context->Block + Block_Len,0,BL_SHA256_BLOCK_SIZE - BL_SHA256_LENGTH_SIZE - Block_Len);
+	/* Bit length, big endian */
+	for(Index = 0 ; Index < 4 ; Index++)
+	{
+		Context->Block[BL_SHA256_BLOCK_SIZE - 8 + Index] = (uint8_t)(Bit_Len_High >> (24 - (8 * Index)));
+		Context->Block[BL_SHA256_BLOCK_SIZE - 4 + Index] = (uint8_t)(Bit_Len_Low >> (24 - (8 * Index)));
+	}
+	BL_SHA256_Transform(Context->State,Context->Block);
+	for(Index = 0 ; Index < BL_SHA256_STATE_WORDS ; Index++)
+	{
+		Digest[(4 * Index)] = (uint8_t)(Context->State[Index] >> 24);
+		Digest[(4 * Index) + 1] = (uint8_t)(Context->State[Index] >> 16);
+		Digest[(4 * Index) + 2] = (uint8_t)(Context->State[Index] >> 8);
+		Digest[(4 * Index) + 3] = (uint8_t)(Context->State[Index]);
+	}
+}
+
+/*******************************************************************************
+*                      Private Functions Definitions                           *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		BL_SHA256_Transform
+********************************************************************************/
+static void BL_SHA256_Transform(uint32_t *State, const uint8_t *Block)
+{
+	uint32_t W[16];
+	uint32_t A = State[0], B = State[1], C = State[2], D = State[3];
+	uint32_t E = State[4], F = State[5], G = State[6], H = State[7];
+	uint32_t T1 = 0;
+	uint8_t Round = 0;
+
+	for(Round = 0 ; Round < 16 ; Round += 8)
+	{
+		BL_SHA256_ROUND(A,B,C,D,E,F,G,H,Round,BL_SHA256_LOAD(Round));
+		BL_SHA256_ROUND(H,A,B,C,D,E,F,G,Round+1,BL_SHA256_LOAD(Round+1));
+		BL_SHA256_ROUND(G,H,A,B,C,D,E,F,Round+2,BL_SHA256_LOAD(Round+2));
+		BL_SHA256_ROUND(F,G,H,A,B,C,D,E,Round+3,BL_SHA256_LOAD(Round+3));
+		BL_SHA256_ROUND(E,F,G,H,A,B,C,D,Round+4,BL_SHA256_LOAD(Round+4));
+		BL_SHA256_ROUND(D,E,F,G,H,A,B,C,Round+5,BL_SHA256_LOAD(Round+5));
+		BL_SHA256_ROUND(C,D,E,F,G,H,A,B,Round+6,BL_SHA256_LOAD(Round+6));
+		BL_SHA256_ROUND(B,C,D,E,F,G,H,A,Round+7,BL_SHA256_LOAD(Round+7));
+	}
+	for( ; Round < 64 ; Round += 8)
+	{
+		BL_SHA256_ROUND(A,B,C,D,E,F,G,H,Round,BL_SHA256_SCHEDULE(Round));
+		BL_SHA256_ROUND(H,A,B,C,D,E,F,G,Round+1,BL_SHA256_SCHEDULE(Round+1));
+		BL_SHA256_ROUND(G,H,A,B,C,D,E,F,Round+2,BL_SHA256_SCHEDULE(Round+2));
+		BL_SHA256_ROUND(F,G,H,A,B,C,D,E,Round+3,BL_SHA256_SCHEDULE(Round+3));
+		BL_SHA256_ROUND(E,F,G,H,A,B,C,D,Round+4,BL_SHA256_SCHEDULE(Round+4));
+		BL_SHA256_ROUND(D,E,F,G,H,A,B,C,Round+5,BL_SHA256_SCHEDULE(Round+5));
+		BL_SHA256_ROUND(C,D,E,F,G,H,A,B,Round+6,BL_SHA256_SCHEDULE(Round+6));
+		BL_SHA256_ROUND(B,C,D,E,F,G,H,A,Round+7,BL_SHA256_SCHEDULE(Round+7));
+	}
+	State[0] += A; State[1] += B; State[2] += C; State[3] += D;
+	State[4] += E; State[5] += F; State[6] += G; State[7] += H;
+}
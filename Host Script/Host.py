@@ -1,8 +1,17 @@
 import serial
+import socket
 import struct
 import os
 import sys
 import glob
+import re
+import base64
+import hashlib
+try:
+    import zlib
+except ImportError:
+    ''' Some embedded Python builds have no zlib, the table CRC is used then '''
+    zlib = None
 from time import sleep
 
 ''' Bootloader Commands '''
@@ -18,6 +27,20 @@ CBL_MEM_READ_CMD             = 0x18
 CBL_READ_SECTOR_STATUS_CMD   = 0x19
 CBL_OTP_READ_CMD             = 0x20
 CBL_CHANGE_ROP_Level_CMD     = 0x21
+CBL_MEM_WRITE_WINDOW_CMD     = 0x22
+CBL_MEM_WRITE_SEQ_CMD        = 0x23
+CBL_CHANGE_BAUD_CMD          = 0x24
+CBL_GET_LINK_STATS_CMD       = 0x25
+CBL_MEM_WRITE_COMPRESSED_CMD = 0x26
+CBL_DELTA_START_CMD          = 0x27
+CBL_DELTA_DATA_CMD           = 0x28
+CBL_MEM_FILL_CMD             = 0x29
+CBL_BATCH_CMD                = 0x2A
+CBL_SET_CRC_MODE_CMD         = 0x2B
+CBL_REGION_CRC_CMD           = 0x2C
+CBL_PAGE_CRC_CMD             = 0x2D
+CBL_PAGE_ERASE_CMD           = 0x2E
+CBL_IMAGE_END_CMD            = 0x2F
 
 INVALID_SECTOR_NUMBER        = 0x00
 VALID_SECTOR_NUMBER          = 0x01
@@ -27,14 +50,96 @@ SUCCESSFUL_ERASE             = 0x03
 FLASH_PAYLOAD_WRITE_FAILED   = 0x00
 FLASH_PAYLOAD_WRITE_PASSED   = 0x01
 
+CBL_SEND_ACK                 = 0xCD
+CBL_SEND_NACK                = 0xAB
+
+CBL_FRAME_V2_MARKER          = 0xFF
+CBL_FRAME_COBS_DELIMITER     = 0x00
+COBS_MAX_CODE                = 0xFF
+FRAMING_RAW                  = 0
+FRAMING_COBS                 = 1
+WRITE_PAYLOAD_SIZE           = 1024   # one flash page per v2 frame
+
+LZ_WINDOW_SIZE               = 256    # must match BL_LZ_WINDOW_SIZE in bootloader.h
+LZ_MIN_MATCH                 = 3
+LZ_MAX_MATCH                 = LZ_MIN_MATCH + 255
+LZ_TOKENS_PER_FLAG           = 8
+
+DELTA_OP_COPY                = 0x01
+DELTA_OP_INSERT              = 0x02
+DELTA_COPY_OP_SIZE           = 7      # a copy shorter than this is sent as new bytes
+DELTA_MAX_OP_LENGTH          = 0xFFFF
+DELTA_MATCH_KEY_SIZE         = 8
+DELTA_MAX_CANDIDATES         = 32
+DELTA_SOURCE_VALID           = 0x01
+DELTA_CRC_MISMATCH           = 0x02
+FLASH_PAGE_SIZE              = 1024
+APP_BASE_ADDRESS             = 0x08008000
+APP_MAX_SIZE                 = 0x7C00 # the last flash page keeps the bootloader metadata
+APP_TRAILER_ADDRESS          = 0x0800FBF0 # must match BL_APP_TRAILER_ADDRESS in bootloader.h
+APP_TRAILER_MAGIC            = 0x50414C42
+APP_SIGNATURE_ADDRESS        = 0x0800FAF0 # must match BL_APP_SIGNATURE_ADDRESS in bootloader.h
+APP_SIGNATURE_SIZE           = 256    # RSA-2048
+APP_IMAGE_VALID              = 0x01
+RSA_PUBLIC_EXPONENT          = 65537
+RSA_WORDS                    = APP_SIGNATURE_SIZE // 4
+SHA256_DIGEST_INFO           = bytes.fromhex('3031300d060960864801650304020105000420')
+ADDRESS_APP_IMAGE_INVALID    = 0x02
+APP_PAGES_NUMBER             = APP_MAX_SIZE // FLASH_PAGE_SIZE
+IMAGE_HASH_MISMATCH          = 0x00
+IMAGE_HASH_MATCH             = 0x01
+
+SPARSE_MIN_GAP               = 16     # shorter 0xFF runs cost less than a new frame header
+
+BATCH_STOP_ON_ERROR          = 0x01
+
+BATCH_COMPLETED              = 0x00
+BATCH_STOPPED_ON_ERROR       = 0x01
+BATCH_BAD_SUB_COMMAND        = 0x02
+BATCH_REPLY_OVERFLOW         = 0x03
+
+CRC_MODE_V1                  = 0x01   # one byte per CRC word
+CRC_MODE_V2                  = 0x02   # little endian words, then the tail bytes as in v1
+CRC_MODE_VALID               = 0x01
+CRC32_POLYNOMIAL             = 0x04C11DB7
+CRC32_RESET_VALUE            = 0xFFFFFFFF
+
+WRITE_WINDOW_SIZE            = 16
+WRITE_WINDOW_PAYLOAD_SIZE    = 256    # small frames so the window covers the round trip
+WRITE_WINDOW_RETRIES         = 10
+
+BL_DEFAULT_BAUD_RATE         = 115200
+BL_SUPPORTED_BAUD_RATES      = [115200, 460800, 921600, 2000000]
+BL_BAUD_CONFIRM_BYTE         = 0xA5
+BAUD_RATE_INVALID            = 0x00
+BAUD_RATE_VALID              = 0x01
+BL_AUTO_BAUD_SYNC_BYTE       = 0x7F
+BL_AUTO_BAUD_RETRIES         = 5
+
+CAN_BL_REQUEST_ID            = 0x7E0  # must match BL_CAN_REQUEST_ID in bootloader.h
+CAN_BL_RESPONSE_ID           = 0x7E8
+CAN_ISOTP_MAX_MESSAGE        = 4095
+CAN_INTERFACE_PREFIXES       = ('can', 'vcan', 'slcan')
+
+REPLY_HEADER_SIZE            = 2
+REPLY_CRC_ENABLE             = 1      # must match BL_ENABLE_REPLY_CRC in bootloader.h
+
 verbose_mode = 1
+Framing_Mode = FRAMING_RAW
+CRC_Mode = CRC_MODE_V1
+Expected_Region_CRC = None
+Page_CRCs = []
 Memory_Write_Active = 0
+Signing_Key = None
 
 def Check_Serial_Ports():
     Serial_Ports = []
     
     if sys.platform.startswith('win'):
         Ports = ['COM%s' % (i + 1) for i in range(256)]
+    elif sys.platform.startswith('linux'):
+        ''' USB serial adapters, and the pseudo-terminals of the native bootloader builds '''
+        Ports = glob.glob('/dev/ttyUSB*') + glob.glob('/dev/ttyACM*') + glob.glob('/dev/pts/[0-9]*')
     else:
         raise EnvironmentError("Error !! Unsupported Platform \n")
     
@@ -48,10 +153,10 @@ def Check_Serial_Ports():
     
     return Serial_Ports
 
-def Serial_Port_Configuration(Port_Number):
+def Serial_Port_Configuration(Port_Number, Baud_Rate):
     global Serial_Port_Obj
     try:
-        Serial_Port_Obj = serial.Serial(Port_Number, 115200, timeout = 2)
+        Serial_Port_Obj = serial.Serial(Port_Number, Baud_Rate, timeout = 2)
     except:
         print("\nError !! That was not a valid port")
     
@@ -68,14 +173,97 @@ def Serial_Port_Configuration(Port_Number):
     else:
         print("Port Open Failed \n")
 
-def Write_Data_To_Serial_Port(Value, Length):
-    _data = struct.pack('>B', Value)
+class CAN_ISOTP_Port:
+    ''' SocketCAN ISO-TP link used like a serial.Serial, every write is one ISO-TP message and
+        the kernel (can-isotp) does the segmentation and the flow control, works on vcan too '''
+    def __init__(self, Interface, Timeout = 2):
+        self.Socket = socket.socket(socket.AF_CAN, socket.SOCK_DGRAM, socket.CAN_ISOTP)
+        self.Socket.bind((Interface, CAN_BL_RESPONSE_ID, CAN_BL_REQUEST_ID))
+        self.Timeout = Timeout
+        self.Socket.settimeout(Timeout)
+        self.Rx_Buffer = bytearray()
+        self.is_open = True
+        self.baudrate = None
+    
+    def write(self, Data):
+        self.Socket.send(bytes(Data))
+    
+    def read(self, Size = 1):
+        ''' A reply frame is one message, keep the bytes past Size for the next read '''
+        while(len(self.Rx_Buffer) < Size):
+            try:
+                self.Rx_Buffer += self.Socket.recv(CAN_ISOTP_MAX_MESSAGE)
+            except socket.timeout:
+                break
+        Data = bytes(self.Rx_Buffer[0 : Size])
+        del self.Rx_Buffer[0 : Size]
+        return Data
+    
+    def reset_input_buffer(self):
+        self.Rx_Buffer = bytearray()
+        self.Socket.setblocking(False)
+        try:
+            while True:
+                self.Socket.recv(CAN_ISOTP_MAX_MESSAGE)
+        except OSError:
+            pass
+        self.Socket.settimeout(self.Timeout)
+
+def CAN_Port_Configuration(Interface):
+    global Serial_Port_Obj
+    try:
+        Serial_Port_Obj = CAN_ISOTP_Port(Interface)
+    except (OSError, AttributeError):
+        print("\nError !! Can't open the ISO-TP socket on", Interface, "(Linux only, modprobe can-isotp and ip link set", Interface, "up)")
+        return -1
+    print("CAN Open Success, requests on", hex(CAN_BL_REQUEST_ID), "replies on", hex(CAN_BL_RESPONSE_ID), "\n")
+
+def Auto_Baud_Sync():
+    ''' The bootloader measures the sync byte and replies with ACK at the same speed '''
+    for Retry in range(BL_AUTO_BAUD_RETRIES):
+        Serial_Port_Obj.reset_input_buffer()
+        Serial_Port_Obj.write(bytearray([BL_AUTO_BAUD_SYNC_BYTE]))
+        Reply = Read_Reply_Frame(0)
+        if(Reply is not None and Reply[0] == CBL_SEND_ACK):
+            print("Bootloader Locked to ", Serial_Port_Obj.baudrate, " baud \n")
+            return 1
+    print("\nError !! The bootloader didn't answer the sync byte (already synced ? reset the board)")
+    return 0
+
+def COBS_Encode(Frame):
+    ''' Each code byte gives the distance to the next zero, a full block (0xFF) has no zero after it '''
+    Encoded = [0]
+    Code_Index = 0
+    Code = 1
+    for Data in Frame:
+        if(Data == 0):
+            Encoded[Code_Index] = Code
+            Code_Index = len(Encoded)
+            Encoded.append(0)
+            Code = 1
+        else:
+            Encoded.append(Data)
+            Code = Code + 1
+            if(Code == COBS_MAX_CODE):
+                Encoded[Code_Index] = Code
+                Code_Index = len(Encoded)
+                Encoded.append(0)
+                Code = 1
+    Encoded[Code_Index] = Code
+    return Encoded
+
+def Write_Frame_To_Serial_Port(Frame):
+    if(Framing_Mode == FRAMING_COBS):
+        ''' A delimiter on both sides so the bootloader drops a corrupted frame at the next one '''
+        Frame = [CBL_FRAME_COBS_DELIMITER] + COBS_Encode(Frame) + [CBL_FRAME_COBS_DELIMITER]
+    Serial_Port_Obj.write(bytearray(Frame))
+
+def Write_Command_To_Serial_Port(Buffer, Length):
+    ''' The whole frame goes in one write, the bootloader drops a frame with a gap of more than 5 ms '''
     if(verbose_mode):
-        Value = bytearray(_data)
-        print("   "+"0x{:02x}".format(Value[0]), end = ' ')
-        if(Memory_Write_Active and (not verbose_mode)):
-            print("#", end = ' ')
-        Serial_Port_Obj.write(_data)
+        for Data in Buffer[0 : Length]:
+            print("   "+"0x{:02x}".format(Data), end = ' ')
+    Write_Frame_To_Serial_Port(Buffer[0 : Length])
 
 def Read_Serial_Port(Data_Len):
     
@@ -92,56 +280,152 @@ def Read_Serial_Port(Data_Len):
     return Serial_Value
     '''
 
+def Read_Reply_Frame(Wait_Reply = 1):
+    ''' Reply frame : [ACK or NACK][Length][Payload][CRC32], the bootloader sends it in one transfer
+        Returns (ACK or NACK, payload) or None on timeout or a corrupted reply '''
+    if(Wait_Reply):
+        Header = bytearray(Read_Serial_Port(REPLY_HEADER_SIZE))
+    else:
+        Header = bytearray(Serial_Port_Obj.read(REPLY_HEADER_SIZE))
+    if(len(Header) < REPLY_HEADER_SIZE):
+        Header = Header + bytearray(Serial_Port_Obj.read(REPLY_HEADER_SIZE - len(Header)))
+        if(len(Header) < REPLY_HEADER_SIZE):
+            return None
+    Rest_Len = Header[1] + (4 if REPLY_CRC_ENABLE else 0)
+    Reply = Header + bytearray(Serial_Port_Obj.read(Rest_Len))
+    if(len(Reply) < REPLY_HEADER_SIZE + Rest_Len):
+        return None
+    if(REPLY_CRC_ENABLE):
+        Reply_CRC = struct.unpack('<I', Reply[-4:])[0]
+        if(Reply_CRC != (Calculate_CRC32(Reply, len(Reply) - 4) & 0xFFFFFFFF)):
+            print("\n   Reply CRC Error !!")
+            return None
+    return (Reply[0], Reply[REPLY_HEADER_SIZE : REPLY_HEADER_SIZE + Header[1]])
+
 def Read_Data_From_Serial_Port(Command_Code):
     Length_To_Follow = 0
     
-    BL_ACK = Read_Serial_Port(2)
-    if(len(BL_ACK)):
-        BL_ACK_Array = bytearray(BL_ACK)
-        if(BL_ACK_Array[0] == 0xCD):
+    BL_Reply = Read_Reply_Frame()
+    if(BL_Reply is not None):
+        BL_Reply_Code, Serial_Data = BL_Reply
+        if(BL_Reply_Code == CBL_SEND_ACK):
             print ("\n   Received Acknowledgement from Bootloader")
-            Length_To_Follow = BL_ACK_Array[1]
-            print("   Preparing to receive (", int(Length_To_Follow), ") bytes from the bootloader")
-            if(Command_Code == CBL_GET_VER_CMD):
-                Process_CBL_GET_VER_CMD(Length_To_Follow)
-            elif (Command_Code == CBL_GET_HELP_CMD):
-                Process_CBL_GET_HELP_CMD(Length_To_Follow)
-            elif (Command_Code == CBL_GET_CID_CMD):
-                Process_CBL_GET_CID_CMD(Length_To_Follow)
-            elif (Command_Code == CBL_GET_RDP_STATUS_CMD):
-                Process_CBL_GET_RDP_STATUS_CMD(Length_To_Follow)
-            elif (Command_Code == CBL_GO_TO_ADDR_CMD):
-                Process_CBL_GO_TO_ADDR_CMD(Length_To_Follow)
-            elif (Command_Code == CBL_FLASH_ERASE_CMD):
-                Process_CBL_FLASH_ERASE_CMD(Length_To_Follow)
-            elif (Command_Code == CBL_MEM_WRITE_CMD):
-                Process_CBL_MEM_WRITE_CMD(Length_To_Follow)
-            elif (Command_Code == CBL_CHANGE_ROP_Level_CMD):
-                Process_CBL_CHANGE_ROP_Level_CMD(Length_To_Follow)
+            Length_To_Follow = len(Serial_Data)
+            print("   Received (", int(Length_To_Follow), ") bytes from the bootloader")
+            Process_Command_Reply(Command_Code, Serial_Data)
         else:
             print ("\n   Received Not-Acknowledgement from Bootloader")
             sys.exit()
+    else:
+        print("\n   Timeout !!, Bootloader reply is missing or corrupted")
         
-def Process_CBL_GET_VER_CMD(Data_Len):
-    Serial_Data = Read_Serial_Port(Data_Len)
+def Process_Command_Reply(Command_Code, Serial_Data):
+    if(Command_Code == CBL_GET_VER_CMD):
+        Process_CBL_GET_VER_CMD(Serial_Data)
+    elif (Command_Code == CBL_GET_HELP_CMD):
+        Process_CBL_GET_HELP_CMD(Serial_Data)
+    elif (Command_Code == CBL_GET_CID_CMD):
+        Process_CBL_GET_CID_CMD(Serial_Data)
+    elif (Command_Code == CBL_GET_RDP_STATUS_CMD):
+        Process_CBL_GET_RDP_STATUS_CMD(Serial_Data)
+    elif (Command_Code == CBL_GO_TO_ADDR_CMD):
+        Process_CBL_GO_TO_ADDR_CMD(Serial_Data)
+    elif (Command_Code == CBL_FLASH_ERASE_CMD):
+        Process_CBL_FLASH_ERASE_CMD(Serial_Data)
+    elif (Command_Code == CBL_MEM_WRITE_CMD):
+        Process_CBL_MEM_WRITE_CMD(Serial_Data)
+    elif (Command_Code == CBL_CHANGE_ROP_Level_CMD):
+        Process_CBL_CHANGE_ROP_Level_CMD(Serial_Data)
+    elif (Command_Code == CBL_CHANGE_BAUD_CMD):
+        Process_CBL_CHANGE_BAUD_CMD(Serial_Data)
+    elif (Command_Code == CBL_GET_LINK_STATS_CMD):
+        Process_CBL_GET_LINK_STATS_CMD(Serial_Data)
+    elif (Command_Code == CBL_MEM_WRITE_COMPRESSED_CMD):
+        Process_CBL_MEM_WRITE_COMPRESSED_CMD(Serial_Data)
+    elif (Command_Code == CBL_DELTA_START_CMD):
+        Process_CBL_DELTA_START_CMD(Serial_Data)
+    elif (Command_Code == CBL_DELTA_DATA_CMD):
+        Process_CBL_DELTA_DATA_CMD(Serial_Data)
+    elif (Command_Code == CBL_MEM_FILL_CMD):
+        Process_CBL_MEM_FILL_CMD(Serial_Data)
+    elif (Command_Code == CBL_SET_CRC_MODE_CMD):
+        Process_CBL_SET_CRC_MODE_CMD(Serial_Data)
+    elif (Command_Code == CBL_REGION_CRC_CMD):
+        Process_CBL_REGION_CRC_CMD(Serial_Data)
+    elif (Command_Code == CBL_PAGE_CRC_CMD):
+        Process_CBL_PAGE_CRC_CMD(Serial_Data)
+    elif (Command_Code == CBL_PAGE_ERASE_CMD):
+        Process_CBL_PAGE_ERASE_CMD(Serial_Data)
+    elif (Command_Code == CBL_IMAGE_END_CMD):
+        Process_CBL_IMAGE_END_CMD(Serial_Data)
+
+def Process_CBL_BATCH_CMD(Commands, Serial_Data):
+    ''' [Executed][Batch Status][ACK or NACK][Length][Payload]... one entry per executed command '''
+    Executed = Serial_Data[0]
+    Batch_Status = Serial_Data[1]
+    Offset = 2
+    for Command_Code in Commands[0 : Executed]:
+        Reply_Code = Serial_Data[Offset]
+        Reply_Len = Serial_Data[Offset + 1]
+        Reply_Payload = Serial_Data[Offset + 2 : Offset + 2 + Reply_Len]
+        Offset = Offset + 2 + Reply_Len
+        print("\n   Command", hex(Command_Code), end = ' ')
+        if(Reply_Code == CBL_SEND_ACK):
+            Process_Command_Reply(Command_Code, Reply_Payload)
+        else:
+            print("\n   Received Not-Acknowledgement from Bootloader")
+    if(Executed < len(Commands)):
+        print("\n   Batch stopped after (", Executed, ") of (", len(Commands), ") commands")
+        if(Batch_Status == BATCH_STOPPED_ON_ERROR):
+            print("   Batch Status -> Stopped On Error ")
+        elif(Batch_Status == BATCH_BAD_SUB_COMMAND):
+            print("   Batch Status -> Bad Sub-Command Length ")
+        elif(Batch_Status == BATCH_REPLY_OVERFLOW):
+            print("   Batch Status -> Reply Overflow, Send The Remaining Commands In Another Batch ")
+
+def Build_Batch_Sub_Command(Command):
+    ''' [Sub Length][Command][Arguments], the batch CRC covers it '''
+    if(Command == 1):
+        return [CBL_GET_VER_CMD]
+    elif(Command == 2):
+        return [CBL_GET_HELP_CMD]
+    elif(Command == 3):
+        return [CBL_GET_CID_CMD]
+    elif(Command == 4):
+        return [CBL_GET_RDP_STATUS_CMD]
+    elif(Command == 5):
+        CBL_Jump_Address = int(input("\n   Please Enter the Address in Hex : "), 16)
+        return [CBL_GO_TO_ADDR_CMD] + list(struct.pack('<I', CBL_Jump_Address))
+    elif(Command == 6):
+        SectorNumber = int(input("\n   Please enter start sector number(0-3)          : "), 16)
+        NumberOfSectors = 0
+        if(SectorNumber != 0xFF):
+            NumberOfSectors = int(input("\n   Please enter number of sectors to erase (4 Max): "), 16)
+        return [CBL_FLASH_ERASE_CMD, SectorNumber, NumberOfSectors]
+    elif(Command == 15):
+        return [CBL_GET_LINK_STATS_CMD]
+    elif(Command == 21):
+        Region_Address = int(input("\n   Enter the start address : "), 16)
+        Region_Length = int(input("   Enter the length in bytes (hex) : "), 16)
+        return [CBL_REGION_CRC_CMD] + list(struct.pack('<II', Region_Address, Region_Length))
+    return None
+
+def Process_CBL_GET_VER_CMD(Serial_Data):
     _value_ = bytearray(Serial_Data)
     print("\n   Bootloader Vendor ID : ", _value_[0])
     print("   Bootloader Version   : ", _value_[1], ".", _value_[2], ".", _value_[3])
 
-def Process_CBL_GET_HELP_CMD(Data_Len):
-    Serial_Data = Read_Serial_Port(Data_Len)
+def Process_CBL_GET_HELP_CMD(Serial_Data):
     _value_ = bytearray(Serial_Data)
     print("\n   Supported Commands : ", end = ' ')
     for command in _value_:
         print(hex(command), end = ' ')
 
-def Process_CBL_GET_CID_CMD(Data_Len):
-    Serial_Data = Read_Serial_Port(Data_Len)
+def Process_CBL_GET_CID_CMD(Serial_Data):
     CID = (Serial_Data[1] << 8) | Serial_Data[0]
     print("\n   Chip Identification Number : ", hex(CID))
 
-def Process_CBL_GET_RDP_STATUS_CMD(Data_Len):
-    Serial_Data = Read_Serial_Port(Data_Len)
+def Process_CBL_GET_RDP_STATUS_CMD(Serial_Data):
     _value_ = bytearray(Serial_Data)
     if(_value_[0] == 0xEE):
         print("\n   Error While Reading FLASH Protection level !!")
@@ -150,17 +434,17 @@ def Process_CBL_GET_RDP_STATUS_CMD(Data_Len):
     elif(_value_[0] == 0x01):
         print("\n   FLASH Protection : LEVEL 1")
 
-def Process_CBL_GO_TO_ADDR_CMD(Data_Len):
-    Serial_Data = Read_Serial_Port(Data_Len)
+def Process_CBL_GO_TO_ADDR_CMD(Serial_Data):
     _value_ = bytearray(Serial_Data)
     if(_value_[0] == 1):
         print("\n   Address Status is Valid")
+    elif(_value_[0] == ADDRESS_APP_IMAGE_INVALID):
+        print("\n   Application image check failed, the bootloader didn't jump")
     else:
         print("\n   Address Status is InValid")
 
-def Process_CBL_FLASH_ERASE_CMD(Data_Len):
+def Process_CBL_FLASH_ERASE_CMD(Serial_Data):
     BL_Erase_Status = 0
-    Serial_Data = Read_Serial_Port(Data_Len)
     if(len(Serial_Data)):
         BL_Erase_Status = bytearray(Serial_Data)
         if(BL_Erase_Status[0] == INVALID_SECTOR_NUMBER):
@@ -174,22 +458,28 @@ def Process_CBL_FLASH_ERASE_CMD(Data_Len):
     else:
         print("Timeout !!, Bootloader is not responding")
 
-def Process_CBL_MEM_WRITE_CMD(Data_Len):
+def Process_CBL_MEM_WRITE_CMD(Serial_Data):
     global Memory_Write_All
     BL_Write_Status = 0
-    Serial_Data = Read_Serial_Port(Data_Len)
     BL_Write_Status = bytearray(Serial_Data)
     if(BL_Write_Status[0] == FLASH_PAYLOAD_WRITE_FAILED):
         print("\n   Write Status -> Write Failed or Invalid Address ")
+        Memory_Write_All = 0
     elif (BL_Write_Status[0] == FLASH_PAYLOAD_WRITE_PASSED):
         print("\n   Write Status -> Write Successfule ")
         Memory_Write_All = Memory_Write_All and FLASH_PAYLOAD_WRITE_PASSED
     else:
         print("Timeout !!, Bootloader is not responding")
+    ''' The end of a session that changed the application area carries the image check '''
+    if(len(BL_Write_Status) >= 6):
+        Image_Status, Verify_Time = struct.unpack('<BI', bytes(BL_Write_Status[1:6]))
+        if(Image_Status == APP_IMAGE_VALID):
+            print("   Application image signature verified in (", Verify_Time, ") us")
+        else:
+            print("   Application image rejected, bad CRC or signature, check time (", Verify_Time, ") us")
 
-def Process_CBL_CHANGE_ROP_Level_CMD(Data_Len):
+def Process_CBL_CHANGE_ROP_Level_CMD(Serial_Data):
     BL_CHANGE_ROP_Level_Status = 0
-    Serial_Data = Read_Serial_Port(Data_Len)
     if(len(Serial_Data)):
         BL_CHANGE_ROP_Level_Status = bytearray(Serial_Data)
         if(BL_CHANGE_ROP_Level_Status[0] == 0x01):
@@ -199,17 +489,513 @@ def Process_CBL_CHANGE_ROP_Level_CMD(Data_Len):
         else:
             print("\n   ROP Level -> Unknown Error")
 
-def Calculate_CRC32(Buffer, Buffer_Length):
-    CRC_Value = 0xFFFFFFFF
-    for DataElem in Buffer[0:Buffer_Length]:
-        CRC_Value = CRC_Value ^ DataElem
-        for DataElemBitLen in range(32):
-            if(CRC_Value & 0x80000000):
-                CRC_Value = (CRC_Value << 1) ^ 0x04C11DB7
+def Process_CBL_CHANGE_BAUD_CMD(Serial_Data):
+    if(len(Serial_Data)):
+        BL_Baud_Status = bytearray(Serial_Data)
+        if(BL_Baud_Status[0] == BAUD_RATE_VALID):
+            ''' The bootloader waits the confirm byte with the new speed and goes back to
+                the speed it had on a failure, not to the default one '''
+            Previous_Baud_Rate = Serial_Port_Obj.baudrate
+            Serial_Port_Obj.baudrate = Requested_Baud_Rate
+            Serial_Port_Obj.reset_input_buffer()
+            Serial_Port_Obj.write(bytearray([BL_BAUD_CONFIRM_BYTE]))
+            Confirm_Echo = Serial_Port_Obj.read(1)
+            if(len(Confirm_Echo) and Confirm_Echo[0] == BL_BAUD_CONFIRM_BYTE):
+                print("\n   Baud Rate Changed to : ", Requested_Baud_Rate)
+            else:
+                Serial_Port_Obj.baudrate = Previous_Baud_Rate
+                print("\n   No Confirmation, Back to : ", Previous_Baud_Rate)
+        else:
+            print("\n   Baud Rate Not Supported by the Bootloader")
+
+def Process_CBL_SET_CRC_MODE_CMD(Serial_Data):
+    global CRC_Mode
+    if(len(Serial_Data)):
+        if(Serial_Data[0] == CRC_MODE_VALID):
+            ''' The reply was checked with the old mode, the next frame goes with the new one '''
+            CRC_Mode = Requested_CRC_Mode
+            print("\n   CRC Mode Changed to : v", CRC_Mode)
+        else:
+            print("\n   CRC Mode Not Supported by the Bootloader")
+
+def Process_CBL_REGION_CRC_CMD(Serial_Data):
+    if(len(Serial_Data) == 4):
+        Region_CRC = struct.unpack('<I', Serial_Data)[0]
+        print("\n   CRC of the flash region : ", hex(Region_CRC))
+        if(Expected_Region_CRC is not None):
+            if(Region_CRC == Expected_Region_CRC):
+                print("   Flash matches the binary file")
             else:
-                CRC_Value = (CRC_Value << 1)
+                print("   Flash doesn't match the binary file, CRC of the file : ", hex(Expected_Region_CRC))
+    else:
+        print("\n   Address or Length is InValid")
+
+def Process_CBL_PAGE_CRC_CMD(Serial_Data):
+    global Page_CRCs
+    if(len(Serial_Data) >= 4):
+        Page_CRCs = list(struct.unpack('<%dI' % (len(Serial_Data) // 4), Serial_Data))
+        print("\n   CRC of (", len(Page_CRCs), ") pages received")
+    else:
+        Page_CRCs = []
+        print("\n   Page Range is InValid")
+
+def Process_CBL_PAGE_ERASE_CMD(Serial_Data):
+    global Memory_Write_All
+    Process_CBL_FLASH_ERASE_CMD(Serial_Data)
+    if(len(Serial_Data) == 0 or Serial_Data[0] != SUCCESSFUL_ERASE):
+        Memory_Write_All = 0
+
+def Process_CBL_IMAGE_END_CMD(Serial_Data):
+    global Memory_Write_All
+    Image_Status, Image_CRC = struct.unpack('<BI', bytes(Serial_Data[0:5]))
+    if(Image_Status == IMAGE_HASH_MATCH):
+        print("\n   Written image verified, CRC : ", hex(Image_CRC))
+    elif(Image_Status == IMAGE_HASH_MISMATCH):
+        print("\n   Written image doesn't match the binary file, CRC of the flash : ", hex(Image_CRC))
+        Memory_Write_All = 0
+    else:
+        print("\n   Nothing written to the application area to verify")
+        Memory_Write_All = 0
+
+def Process_CBL_GET_LINK_STATS_CMD(Serial_Data):
+    if(len(Serial_Data) == 8):
+        Resyncs, Timeouts = struct.unpack('<II', Serial_Data)
+        print("\n   Frames dropped to resync : ", Resyncs)
+        print("   Frames timed out         : ", Timeouts)
+
+def Process_CBL_MEM_WRITE_COMPRESSED_CMD(Serial_Data):
+    global Memory_Write_All
+    if(len(Serial_Data) == 5):
+        Write_Status, Output_Total = struct.unpack('<BI', Serial_Data)
+        if(Write_Status == FLASH_PAYLOAD_WRITE_PASSED):
+            print("\n   Write Status -> Write Successfule, Bytes decompressed : ", Output_Total)
+        else:
+            print("\n   Write Status -> Write Failed, Invalid Address or Corrupted Stream ")
+            Memory_Write_All = 0
+
+def Process_CBL_DELTA_START_CMD(Serial_Data):
+    global Memory_Write_All
+    if(len(Serial_Data) and Serial_Data[0] == DELTA_SOURCE_VALID):
+        print("\n   Installed image matches the patch source")
+    else:
+        print("\n   Installed image doesn't match the patch source, use the memory write")
+        Memory_Write_All = 0
+
+def Process_CBL_DELTA_DATA_CMD(Serial_Data):
+    global Memory_Write_All
+    if(len(Serial_Data) == 5):
+        Write_Status, Output_Total = struct.unpack('<BI', Serial_Data)
+        if(Write_Status == FLASH_PAYLOAD_WRITE_PASSED):
+            print("\n   Delta Status -> New image bytes built : ", Output_Total)
+        elif(Write_Status == DELTA_CRC_MISMATCH):
+            print("\n   Delta Status -> New image CRC mismatch, use the memory write")
+            Memory_Write_All = 0
+        else:
+            print("\n   Delta Status -> Write Failed or Corrupted Patch ")
+            Memory_Write_All = 0
+
+def Process_CBL_MEM_FILL_CMD(Serial_Data):
+    if(len(Serial_Data)):
+        if(Serial_Data[0] == FLASH_PAYLOAD_WRITE_PASSED):
+            print("\n   Fill Status -> Fill Successfule ")
+        else:
+            print("\n   Fill Status -> Fill Failed, Invalid Range or Flash Not Erased ")
+
+def Delta_Generate(Old_Image, New_Image):
+    ''' copy : [0x01][Source Offset (4)][Length (2)], insert : [0x02][Length (2)][New bytes]
+        The bootloader overwrites the image page by page, so a byte may only be copied
+        from the page it goes to or from a later page '''
+    Patch = bytearray()
+    Inserted = bytearray()
+    Key_Table = {}
+    for Offset in range(len(Old_Image) - DELTA_MATCH_KEY_SIZE + 1):
+        Key_Table.setdefault(bytes(Old_Image[Offset : Offset + DELTA_MATCH_KEY_SIZE]), []).append(Offset)
+    
+    def Copy_Length(Source, Position):
+        Length = 0
+        while(Length < DELTA_MAX_OP_LENGTH and Position + Length < len(New_Image) and Source + Length < len(Old_Image)
+              and Old_Image[Source + Length] == New_Image[Position + Length]
+              and Source + Length >= (Position + Length) - ((Position + Length) % FLASH_PAGE_SIZE)):
+            Length = Length + 1
+        return Length
+    
+    def Flush_Inserted():
+        for Offset in range(0, len(Inserted), DELTA_MAX_OP_LENGTH):
+            Chunk = Inserted[Offset : Offset + DELTA_MAX_OP_LENGTH]
+            Patch.extend(struct.pack('<BH', DELTA_OP_INSERT, len(Chunk)) + Chunk)
+        del Inserted[:]
+    
+    Position = 0
+    Shift = 0
+    while(Position < len(New_Image)):
+        ''' Try the shift of the last copy first, then the old positions with the same bytes '''
+        Best_Length = Copy_Length(Position + Shift, Position) if (Position + Shift) >= 0 else 0
+        Best_Source = Position + Shift
+        for Source in Key_Table.get(bytes(New_Image[Position : Position + DELTA_MATCH_KEY_SIZE]), [])[-DELTA_MAX_CANDIDATES:]:
+            Length = Copy_Length(Source, Position)
+            if(Length > Best_Length):
+                Best_Length = Length
+                Best_Source = Source
+        if(Best_Length > DELTA_COPY_OP_SIZE):
+            Flush_Inserted()
+            Patch.extend(struct.pack('<BIH', DELTA_OP_COPY, Best_Source, Best_Length))
+            Shift = Best_Source - Position
+            Position = Position + Best_Length
+        else:
+            Inserted.append(New_Image[Position])
+            Position = Position + 1
+    Flush_Inserted()
+    return Patch
+
+def LZ_Compress(Data):
+    ''' LZSS : a flag byte then up to 8 tokens, a set flag bit (LSB first) is a literal byte
+        and a clear one a match [distance - 1][length - 3] from the last 256 output bytes '''
+    Output = bytearray()
+    Prefix_Table = {}
+    Position = 0
+    while(Position < len(Data)):
+        Flags_Index = len(Output)
+        Output.append(0)
+        for Token in range(LZ_TOKENS_PER_FLAG):
+            if(Position >= len(Data)):
+                break
+            Best_Length = 0
+            Best_Distance = 0
+            ''' Newest candidates first, stop when they leave the window '''
+            for Candidate in reversed(Prefix_Table.get(bytes(Data[Position : Position + LZ_MIN_MATCH]), [])):
+                Distance = Position - Candidate
+                if(Distance > LZ_WINDOW_SIZE):
+                    break
+                Length = 0
+                while(Length < LZ_MAX_MATCH and Position + Length < len(Data) and Data[Candidate + Length] == Data[Position + Length]):
+                    Length = Length + 1
+                if(Length > Best_Length):
+                    Best_Length = Length
+                    Best_Distance = Distance
+            if(Best_Length >= LZ_MIN_MATCH):
+                Output.extend([Best_Distance - 1, Best_Length - LZ_MIN_MATCH])
+                Step = Best_Length
+            else:
+                Output[Flags_Index] |= (1 << Token)
+                Output.append(Data[Position])
+                Step = 1
+            for Index in range(Position, Position + Step):
+                Prefix_Table.setdefault(bytes(Data[Index : Index + LZ_MIN_MATCH]), []).append(Index)
+            Position = Position + Step
+    return Output
+
+def Build_CRC32_Tables():
+    ''' Slicing by 4 : Tables[k][v] is what the CRC engine makes of a word holding v in byte k,
+        the engine is linear so a word is the XOR of its four bytes '''
+    Tables = []
+    for Byte_Index in range(4):
+        Table = []
+        for Value in range(256):
+            CRC_Value = Value << (8 * Byte_Index)
+            for Bit in range(32):
+                if(CRC_Value & 0x80000000):
+                    CRC_Value = ((CRC_Value << 1) ^ CRC32_POLYNOMIAL) & 0xFFFFFFFF
+                else:
+                    CRC_Value = (CRC_Value << 1) & 0xFFFFFFFF
+            Table.append(CRC_Value)
+        Tables.append(Table)
+    return Tables
+
+CRC32_Tables = Build_CRC32_Tables()
+BIT_REVERSE_TABLE = bytes(int('{:08b}'.format(Value)[::-1], 2) for Value in range(256))
+
+def Calculate_CRC32_Tables(Data, Mode):
+    ''' One engine word is four table reads : a v2 word goes in whole, a v1 byte is a word
+        holding the byte in its low 8 bits '''
+    Table_0, Table_1, Table_2, Table_3 = CRC32_Tables
+    CRC_Value = CRC32_RESET_VALUE
+    Words_Len = (len(Data) & ~3) if (Mode == CRC_MODE_V2) else 0
+    for Data_Word in struct.unpack('<%dI' % (Words_Len // 4), Data[0:Words_Len]):
+        CRC_Value = CRC_Value ^ Data_Word
+        CRC_Value = Table_3[CRC_Value >> 24] ^ Table_2[(CRC_Value >> 16) & 0xFF] ^ Table_1[(CRC_Value >> 8) & 0xFF] ^ Table_0[CRC_Value & 0xFF]
+    for Data_Byte in Data[Words_Len:]:
+        CRC_Value = Table_3[CRC_Value >> 24] ^ Table_2[(CRC_Value >> 16) & 0xFF] ^ Table_1[(CRC_Value >> 8) & 0xFF] ^ Table_0[(CRC_Value & 0xFF) ^ Data_Byte]
     return CRC_Value
+
+def Calculate_CRC32_Native(Data, Mode):
+    ''' zlib runs the same polynomial in C but bit reflected : give it the bytes in the order the
+        engine shifts them (each word MSB first, a v1 byte after three zero bytes), with their
+        bits reversed, and reverse the bits of the result. zlib inverts the value in and out,
+        the engine only starts from 0xFFFFFFFF, so the result is inverted back '''
+    Words_Len = (len(Data) & ~3) if (Mode == CRC_MODE_V2) else 0
+    Stream = bytearray(Words_Len + 4 * (len(Data) - Words_Len))
+    for Byte_Index in range(4):
+        Stream[Byte_Index : Words_Len : 4] = Data[3 - Byte_Index : Words_Len : 4]
+    Stream[Words_Len + 3 : : 4] = Data[Words_Len:]
+    Reflected_CRC = zlib.crc32(Stream.translate(BIT_REVERSE_TABLE)) ^ 0xFFFFFFFF
+    return int('{:032b}'.format(Reflected_CRC)[::-1], 2)
+
+def Calculate_CRC32(Buffer, Buffer_Length, Mode = None):
+    ''' Same as the STM32 CRC engine, in v2 the whole words go first and the 1 to 3 tail bytes
+        are fed one word each, the link CRC mode is used if no mode is given '''
+    Data = bytes(Buffer[0:Buffer_Length])
+    if(Mode is None):
+        Mode = CRC_Mode
+    if(zlib is not None):
+        return Calculate_CRC32_Native(Data, Mode)
+    return Calculate_CRC32_Tables(Data, Mode)
     
+def Build_Extended_Frame(Body):
+    ''' v2 frame : [0xFF][Length Low][Length High][Command][Arguments][CRC32]
+        The length counts the bytes after it and the CRC skips the two length bytes '''
+    Frame = [CBL_FRAME_V2_MARKER] + list(Body)
+    CRC32_Value = Calculate_CRC32(Frame, len(Frame)) & 0xFFFFFFFF
+    for Byte_Index in range(1, 5):
+        Frame.append(Word_Value_To_Byte_Value(CRC32_Value, Byte_Index, 1))
+    Frame_Len = len(Frame) - 1
+    return [CBL_FRAME_V2_MARKER, Frame_Len & 0xFF, (Frame_Len >> 8) & 0xFF] + Frame[1:]
+
+def DER_Read(Data, Offset):
+    ''' One DER element : returns its tag, its contents and the offset after it '''
+    Tag = Data[Offset]
+    Length = Data[Offset + 1]
+    Offset = Offset + 2
+    if(Length & 0x80):
+        Length_Size = Length & 0x7F
+        Length = int.from_bytes(Data[Offset : Offset + Length_Size], 'big')
+        Offset = Offset + Length_Size
+    return Tag, Data[Offset : Offset + Length], Offset + Length
+
+def Load_Signing_Key(Key_File):
+    ''' RSA-2048 private key in PEM, PKCS#1 (openssl genrsa -traditional) or PKCS#8,
+        returns (Modulus, Private Exponent) or None if the file isn't such a key.
+        The errors go to stderr as the public key export prints bootloader_key.c to stdout '''
+    if(not os.path.exists(Key_File)):
+        print("Error !! The signing key", Key_File, "doesn't exist, make one with : openssl genrsa -traditional -out", Key_File, "2048", file = sys.stderr)
+        return None
+    Key_Text = open(Key_File).read()
+    PEM = re.search(r'-----BEGIN ([A-Z ]+)-----(.*?)-----END', Key_Text, re.S)
+    if(PEM is None or 'PRIVATE KEY' not in PEM.group(1)):
+        print("Error !!", Key_File, "isn't a PEM private key", file = sys.stderr)
+        return None
+    Tag, Sequence, Offset = DER_Read(base64.b64decode(''.join(PEM.group(2).split())), 0)
+    if(PEM.group(1) == 'PRIVATE KEY'):
+        ''' PKCS#8 : version, algorithm, then the PKCS#1 key in an octet string '''
+        Tag, Value, Offset = DER_Read(Sequence, 0)
+        Tag, Value, Offset = DER_Read(Sequence, Offset)
+        Tag, Value, Offset = DER_Read(Sequence, Offset)
+        Tag, Sequence, Offset = DER_Read(Value, 0)
+    Integers = []
+    Offset = 0
+    while(Offset < len(Sequence)):
+        Tag, Value, Offset = DER_Read(Sequence, Offset)
+        Integers.append(int.from_bytes(Value, 'big'))
+    ''' version, modulus, public exponent, private exponent, ... '''
+    if(Integers[1].bit_length() != APP_SIGNATURE_SIZE * 8 or Integers[2] != RSA_PUBLIC_EXPONENT):
+        print("Error !! The signing key must be RSA-2048 with the exponent 65537", file = sys.stderr)
+        return None
+    return Integers[1], Integers[3]
+
+def Sign_Image(Image):
+    ''' RSA-2048 PKCS#1 v1.5 signature of the SHA-256 of the image with the key given by --key,
+        the signature is left erased (all 0xFF) without a key '''
+    if(Signing_Key is None):
+        print("\n   Not signed : no signing key given (python Host.py --key <key.pem>), a BL with")
+        print("   BL_ENABLE_APP_SIGNATURE_CHECK won't run this image")
+        return b'\xff' * APP_SIGNATURE_SIZE
+    Modulus, Private_Exponent = Signing_Key
+    Digest = SHA256_DIGEST_INFO + hashlib.sha256(bytes(Image)).digest()
+    Encoded_Message = b'\x00\x01' + b'\xff' * (APP_SIGNATURE_SIZE - 3 - len(Digest)) + b'\x00' + Digest
+    return pow(int.from_bytes(Encoded_Message, 'big'), Private_Exponent, Modulus).to_bytes(APP_SIGNATURE_SIZE, 'big')
+
+def Export_Public_Key(Key_File, Key):
+    ''' Print bootloader_key.c for the signing key, the Montgomery constants are worked out
+        here so the bootloader has no division to do '''
+    Modulus = Key[0]
+    N0_Inv = (-pow(Modulus, -1, 1 << 32)) & 0xFFFFFFFF
+    RR = pow(2, APP_SIGNATURE_SIZE * 8 * 2, Modulus)
+    def Words_Source(Value):
+        Words = ["0x%08X" % ((Value >> (32 * Index)) & 0xFFFFFFFF) for Index in range(RSA_WORDS)]
+        return ",\n".join("\t\t" + ", ".join(Words[Index : Index + 8]) for Index in range(0, RSA_WORDS, 8))
+    print("/******************************************************************************")
+    print("*  File name:\t\tbootloader_key.c")
+    print("*  Version:         1.0")
+    print("*******************************************************************************/")
+    print("")
+    print("/* Public key of the application images, made by python Host.py --export-key from", os.path.basename(Key_File), "*/")
+    print("")
+    print("#include <stdint.h>")
+    print("#include \"bootloader_signature.h\"")
+    print("")
+    print("const BL_RSA_Public_Key BL_App_Public_Key =")
+    print("{")
+    print("\t0x%08X," % N0_Inv)
+    print("\t{")
+    print(Words_Source(Modulus))
+    print("\t},")
+    print("\t{")
+    print(Words_Source(RR))
+    print("\t}")
+    print("};")
+
+def Add_Image_Trailer(Image, BaseMemoryAddress):
+    ''' An image for the application area gets the signature and the trailer the bootloader checks
+        before it jumps : [Signature][Magic][Image Length][Image CRC32 v2][Magic ^ Length ^ CRC] at
+        the end of the area, the 0xFF gap before it is skipped by the sparse write and compresses to nothing '''
+    Signature_Offset = APP_SIGNATURE_ADDRESS - APP_BASE_ADDRESS
+    if(BaseMemoryAddress != APP_BASE_ADDRESS or len(Image) == 0 or len(Image) > Signature_Offset):
+        return Image
+    Image_CRC = Calculate_CRC32(Image, len(Image), CRC_MODE_V2) & 0xFFFFFFFF
+    Trailer = struct.pack('<IIII', APP_TRAILER_MAGIC, len(Image), Image_CRC, APP_TRAILER_MAGIC ^ len(Image) ^ Image_CRC)
+    return bytes(Image) + b'\xff' * (Signature_Offset - len(Image)) + Sign_Image(Image) + Trailer
+
+def Verify_Image_End(Image, BaseMemoryAddress):
+    ''' The bootloader keeps a CRC of the application area while it programs it, send the image
+        length and its CRC so the flash is checked without reading it again '''
+    if(BaseMemoryAddress != APP_BASE_ADDRESS or len(Image) == 0):
+        return
+    Image_CRC = Calculate_CRC32(Image, len(Image), CRC_MODE_V2) & 0xFFFFFFFF
+    Write_Frame_To_Serial_Port(Build_Extended_Frame([CBL_IMAGE_END_CMD] + list(struct.pack('<II', len(Image), Image_CRC))))
+    Read_Data_From_Serial_Port(CBL_IMAGE_END_CMD)
+
+def Changed_Page_Runs(Image):
+    ''' Get the CRC of every page the image covers and compare them with the image pages,
+        returns the (first page, number of pages) runs of consecutive changed pages '''
+    Pages_Number = len(Image) // FLASH_PAGE_SIZE
+    Write_Frame_To_Serial_Port(Build_Extended_Frame([CBL_PAGE_CRC_CMD] + list(struct.pack('<HH', 0, Pages_Number))))
+    Read_Data_From_Serial_Port(CBL_PAGE_CRC_CMD)
+    if(len(Page_CRCs) != Pages_Number):
+        return None
+    Runs = []
+    for Page in range(Pages_Number):
+        Page_Data = Image[Page * FLASH_PAGE_SIZE : (Page + 1) * FLASH_PAGE_SIZE]
+        if((Calculate_CRC32(Page_Data, FLASH_PAGE_SIZE) & 0xFFFFFFFF) != Page_CRCs[Page]):
+            if(len(Runs) and Runs[-1][0] + Runs[-1][1] == Page):
+                Runs[-1] = (Runs[-1][0], Runs[-1][1] + 1)
+            else:
+                Runs.append((Page, 1))
+    return Runs
+
+def Image_Extents(Image):
+    ''' Parts of the image that are not erased flash (0xFF), the bootloader programs half
+        words so every extent starts and ends on an even offset '''
+    Extents = []
+    Start = 0
+    for Gap in re.finditer(b'\xff{%d,}' % SPARSE_MIN_GAP, Image):
+        Gap_Start = (Gap.start() + 1) & ~1
+        Gap_End = Gap.end() & ~1
+        if(Gap_Start > Start):
+            Extents.append((Start, Image[Start : Gap_Start]))
+        Start = Gap_End
+    if(Start < len(Image)):
+        Extents.append((Start, Image[Start : ]))
+    return Extents
+
+def Build_Write_Frame(Address, Payload):
+    Body = [CBL_MEM_WRITE_CMD]
+    for Byte_Index in range(1, 5):
+        Body.append(Word_Value_To_Byte_Value(Address, Byte_Index, 1))
+    Body.extend([len(Payload) & 0xFF, (len(Payload) >> 8) & 0xFF])
+    Body.extend(Payload)
+    return Build_Extended_Frame(Body)
+
+def Build_Write_Compressed_Frame(Address, Payload):
+    Body = [CBL_MEM_WRITE_COMPRESSED_CMD]
+    for Byte_Index in range(1, 5):
+        Body.append(Word_Value_To_Byte_Value(Address, Byte_Index, 1))
+    Body.extend([len(Payload) & 0xFF, (len(Payload) >> 8) & 0xFF])
+    Body.extend(Payload)
+    return Build_Extended_Frame(Body)
+
+def Build_Delta_Data_Frame(Payload):
+    Body = [CBL_DELTA_DATA_CMD, len(Payload) & 0xFF, (len(Payload) >> 8) & 0xFF]
+    Body.extend(Payload)
+    return Build_Extended_Frame(Body)
+
+def Build_Write_Sequenced_Frame(Sequence_Number, Address, Payload):
+    Body = [CBL_MEM_WRITE_SEQ_CMD, Sequence_Number & 0xFF, (Sequence_Number >> 8) & 0xFF]
+    for Byte_Index in range(1, 5):
+        Body.append(Word_Value_To_Byte_Value(Address, Byte_Index, 1))
+    Body.extend([len(Payload) & 0xFF, (len(Payload) >> 8) & 0xFF])
+    Body.extend(Payload)
+    return Build_Extended_Frame(Body)
+
+def Read_Window_Reply():
+    ''' Returns (ACK or NACK, sequence number, write status) or None on timeout '''
+    Reply = Read_Reply_Frame(0)
+    if(Reply is None or len(Reply[1]) < 3):
+        return None
+    Reply_Code, Payload = Reply
+    return (Reply_Code, Payload[0] | (Payload[1] << 8), Payload[2])
+
+def Memory_Write_Windowed(BaseMemoryAddress, Window_Size):
+    global Memory_Write_All
+    ''' Open the session and take the window granted by the bootloader '''
+    Frame = [8, CBL_MEM_WRITE_WINDOW_CMD, Window_Size, WRITE_WINDOW_PAYLOAD_SIZE & 0xFF, (WRITE_WINDOW_PAYLOAD_SIZE >> 8) & 0xFF]
+    CRC32_Value = Calculate_CRC32(Frame, 5) & 0xFFFFFFFF
+    for Byte_Index in range(1, 5):
+        Frame.append(Word_Value_To_Byte_Value(CRC32_Value, Byte_Index, 1))
+    Write_Frame_To_Serial_Port(Frame)
+    Reply = Read_Reply_Frame()
+    if(Reply is None or Reply[0] != CBL_SEND_ACK or len(Reply[1]) < 1):
+        print("\n   Bootloader refused the sliding window session")
+        return 0
+    Window_Size = Reply[1][0]
+    print("   Window size granted by the bootloader :", Window_Size)
+    
+    ''' Split the binary file into numbered frames, the last one is empty and closes the session '''
+    Frames = []
+    BinFile_Data = Add_Image_Trailer(BinFile.read(), BaseMemoryAddress)
+    for Extent_Offset, Extent_Data in Image_Extents(BinFile_Data):
+        for Offset in range(0, len(Extent_Data), WRITE_WINDOW_PAYLOAD_SIZE):
+            Frames.append(Build_Write_Sequenced_Frame(len(Frames), BaseMemoryAddress + Extent_Offset + Offset, Extent_Data[Offset : Offset + WRITE_WINDOW_PAYLOAD_SIZE]))
+    Frames.append(Build_Write_Sequenced_Frame(len(Frames), BaseMemoryAddress, []))
+    
+    Base_Frame = 0
+    Next_Frame = 0
+    Retries = 0
+    while(Base_Frame < len(Frames)):
+        ''' Keep the window full '''
+        while(Next_Frame < len(Frames) and (Next_Frame - Base_Frame) < Window_Size):
+            Write_Frame_To_Serial_Port(Frames[Next_Frame])
+            Next_Frame = Next_Frame + 1
+        
+        Reply = Read_Window_Reply()
+        if(Reply is None):
+            ''' Nothing acknowledged, go back and resend the whole window '''
+            Retries = Retries + 1
+            if(Retries > WRITE_WINDOW_RETRIES):
+                print("\n   Timeout !!, Bootloader is not responding")
+                return 0
+            Serial_Port_Obj.reset_input_buffer()
+            Next_Frame = Base_Frame
+            continue
+        
+        Reply_Code, Sequence_Number, Write_Status = Reply
+        ''' Map the 16 bit sequence number back to the frame index '''
+        Frame_Index = Base_Frame + ((Sequence_Number - Base_Frame) & 0xFFFF)
+        if(Reply_Code == CBL_SEND_ACK):
+            if(Write_Status != FLASH_PAYLOAD_WRITE_PASSED):
+                print("\n   Write Status -> Write Failed or Invalid Address ")
+                return 0
+            if(Frame_Index < Next_Frame):
+                Base_Frame = Frame_Index + 1
+                Retries = 0
+        elif(Reply_Code == CBL_SEND_NACK and Frame_Index == len(Frames)):
+            ''' The session closed but its last ACK was lost, the NACK carries the close status '''
+            if(Write_Status != FLASH_PAYLOAD_WRITE_PASSED):
+                print("\n   Write Status -> Write Failed or Invalid Address ")
+                return 0
+            Base_Frame = Frame_Index
+        elif(Reply_Code == CBL_SEND_NACK):
+            ''' Every frame before the missing one is accepted, resend from it '''
+            Retries = Retries + 1
+            if(Retries > WRITE_WINDOW_RETRIES):
+                print("\n   Too many frames lost, write aborted")
+                return 0
+            if(Frame_Index <= Next_Frame):
+                Base_Frame = Frame_Index
+                Next_Frame = Frame_Index
+        print("\r   Frames acknowledged by the bootloader :{0}/{1}".format(Base_Frame, len(Frames)), end = ' ')
+    Memory_Write_All = 1
+    Verify_Image_End(BinFile_Data, BaseMemoryAddress)
+    return Memory_Write_All
+
 def Word_Value_To_Byte_Value(Word_Value, Byte_Index, Byte_Lower_First):
     Byte_Value = (Word_Value >> (8 * (Byte_Index - 1)) & 0x000000FF)
     return Byte_Value
@@ -242,9 +1028,7 @@ def Decode_CBL_Command(Command):
         BL_Host_Buffer[3] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
         BL_Host_Buffer[4] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
         BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-        Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-        for Data in BL_Host_Buffer[1 : CBL_GET_VER_CMD_Len]:
-            Write_Data_To_Serial_Port(Data, CBL_GET_VER_CMD_Len - 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_GET_VER_CMD_Len)
         Read_Data_From_Serial_Port(CBL_GET_VER_CMD)
     elif (Command == 2):
         print("Read the commands supported by the bootloader")
@@ -257,9 +1041,7 @@ def Decode_CBL_Command(Command):
         BL_Host_Buffer[3] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
         BL_Host_Buffer[4] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
         BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-        Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-        for Data in BL_Host_Buffer[1 : CBL_GET_HELP_CMD_Len]:
-            Write_Data_To_Serial_Port(Data, CBL_GET_HELP_CMD_Len - 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_GET_HELP_CMD_Len)
         Read_Data_From_Serial_Port(CBL_GET_HELP_CMD)
     elif (Command == 3):
         print("Read the MCU chip identification number")
@@ -272,9 +1054,7 @@ def Decode_CBL_Command(Command):
         BL_Host_Buffer[3] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
         BL_Host_Buffer[4] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
         BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-        Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-        for Data in BL_Host_Buffer[1 : CBL_GET_CID_CMD_Len]:
-            Write_Data_To_Serial_Port(Data, CBL_GET_CID_CMD_Len - 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_GET_CID_CMD_Len)
         Read_Data_From_Serial_Port(CBL_GET_CID_CMD)
     elif (Command == 4):
         print("Read the FLASH Read Protection level")
@@ -287,9 +1067,7 @@ def Decode_CBL_Command(Command):
         BL_Host_Buffer[3] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
         BL_Host_Buffer[4] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
         BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-        Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-        for Data in BL_Host_Buffer[1 : CBL_GET_RDP_STATUS_CMD_Len]:
-            Write_Data_To_Serial_Port(Data, CBL_GET_RDP_STATUS_CMD_Len - 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_GET_RDP_STATUS_CMD_Len)
         Read_Data_From_Serial_Port(CBL_GET_RDP_STATUS_CMD)
     elif (Command == 5):
         print("Jump bootloader to specified address command")
@@ -308,9 +1086,7 @@ def Decode_CBL_Command(Command):
         BL_Host_Buffer[7] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
         BL_Host_Buffer[8] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
         BL_Host_Buffer[9] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-        Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-        for Data in BL_Host_Buffer[1 : CBL_GO_TO_ADDR_CMD_Len]:
-            Write_Data_To_Serial_Port(Data, CBL_GO_TO_ADDR_CMD_Len - 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_GO_TO_ADDR_CMD_Len)
         Read_Data_From_Serial_Port(CBL_GO_TO_ADDR_CMD)
     elif (Command == 6):
         print("Mass erase or sector erase of the user flash command")
@@ -331,16 +1107,13 @@ def Decode_CBL_Command(Command):
         BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
         BL_Host_Buffer[6] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
         BL_Host_Buffer[7] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-        Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-        for Data in BL_Host_Buffer[1 : CBL_FLASH_ERASE_CMD_Len]:
-            Write_Data_To_Serial_Port(Data, CBL_FLASH_ERASE_CMD_Len - 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_FLASH_ERASE_CMD_Len)
         Read_Data_From_Serial_Port(CBL_FLASH_ERASE_CMD)
     elif (Command == 7):
         print("Write data into different memories of the MCU command")
         global Memory_Write_Is_Active
         global Memory_Write_All
         File_Total_Len = 0
-        BinFileRemainingBytes = 0
         BinFileSentBytes = 0
         BaseMemoryAddress = 0
         BinFileReadLength = 0
@@ -351,75 +1124,206 @@ def Decode_CBL_Command(Command):
         print("   Preparing writing a binary file with length (", File_Total_Len, ") Bytes")
         ''' Open the binary file '''
         OpenBinFile()
-        ''' Calculate the remaining payload '''
-        BinFileRemainingBytes = File_Total_Len - BinFileSentBytes
         ''' Get the start address to write the payload '''
         BaseMemoryAddress = input("\n   Enter the start address : ")
         BaseMemoryAddress = int(BaseMemoryAddress, 16)
-        ''' Keep sending the write packet till the last payload byte '''
-        while(BinFileRemainingBytes):
-            ''' Memory write is active '''
-            Memory_Write_Is_Active = 1
-            
-            ''' Read 128 bytes from the binary file each time '''
-            if(BinFileRemainingBytes >= 128):
-                BinFileReadLength = 128
-            else:
-                BinFileReadLength = BinFileRemainingBytes
-            
-            for BinFileByte in range(BinFileReadLength):
-                BinFileByteValue = BinFile.read(1)
-                BinFileByteValue = bytearray(BinFileByteValue)
-                BL_Host_Buffer[7 + BinFileByte] = int(BinFileByteValue[0])
-            
-            ''' Update the Host packet with the command code ID '''
-            BL_Host_Buffer[1] = CBL_MEM_WRITE_CMD
+        ''' Only the extents that are not erased flash (0xFF) are sent, a page at most per packet '''
+        BinFile_Data = Add_Image_Trailer(BinFile.read(), BaseMemoryAddress)
+        for Extent_Offset, Extent_Data in Image_Extents(BinFile_Data):
+            for Offset in range(0, len(Extent_Data), WRITE_PAYLOAD_SIZE):
+                ''' Memory write is active '''
+                Memory_Write_Is_Active = 1
+                
+                ''' Build a v2 frame (16 bit length) with the address and the payload '''
+                BinFileReadLength = min(WRITE_PAYLOAD_SIZE, len(Extent_Data) - Offset)
+                CBL_MEM_WRITE_Frame = Build_Write_Frame(BaseMemoryAddress + Extent_Offset + Offset, Extent_Data[Offset : Offset + BinFileReadLength])
+                
+                ''' Send the complete packet to the bootloader '''
+                Write_Frame_To_Serial_Port(CBL_MEM_WRITE_Frame)
+                
+                ''' Update the total number of bytes sent to the bootloader '''
+                BinFileSentBytes = BinFileSentBytes + BinFileReadLength
+                print("\n   Bytes sent to the bootloader :{0}".format(BinFileSentBytes))
+                
+                ''' Read the response from the bootloader, the packet is programmed while we send the next one '''
+                BL_Return_Value = Read_Data_From_Serial_Port(CBL_MEM_WRITE_CMD)
+        print("\n   Erased bytes skipped : ", len(BinFile_Data) - BinFileSentBytes)
         
-            ''' Update the Host packet with the base address '''
-            BL_Host_Buffer[2] = Word_Value_To_Byte_Value(BaseMemoryAddress, 1, 1)
-            BL_Host_Buffer[3] = Word_Value_To_Byte_Value(BaseMemoryAddress, 2, 1)
-            BL_Host_Buffer[4] = Word_Value_To_Byte_Value(BaseMemoryAddress, 3, 1)
-            BL_Host_Buffer[5] = Word_Value_To_Byte_Value(BaseMemoryAddress, 4, 1)
-            
-            ''' Update the Host packet with the payload length '''
-            BL_Host_Buffer[6] = BinFileReadLength
-            
-            ''' Update the Host packet with the packet length '''
-            CBL_MEM_WRITE_CMD_Len = (BinFileReadLength + 11)
-            BL_Host_Buffer[0] = CBL_MEM_WRITE_CMD_Len - 1
-            
-            ''' Update the Host packet with the calculated CRC32 '''
-            CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_MEM_WRITE_CMD_Len - 4) 
-            CRC32_Value = CRC32_Value & 0xFFFFFFFF
-            BL_Host_Buffer[7 + BinFileReadLength] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
-            BL_Host_Buffer[8 + BinFileReadLength] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
-            BL_Host_Buffer[9 + BinFileReadLength] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
-            BL_Host_Buffer[10+ BinFileReadLength] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-            
-            ''' Calculate the next Base memory address '''
-            BaseMemoryAddress = BaseMemoryAddress + BinFileReadLength
-            
-            ''' Send the packet length to the bootloader '''
-            Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-            
-            ''' Send the complete packet to the bootloader '''
-            for Data in BL_Host_Buffer[1 : CBL_MEM_WRITE_CMD_Len]:
-                Write_Data_To_Serial_Port(Data, CBL_MEM_WRITE_CMD_Len - 1)
-            
-            ''' Update the total number of bytes sent to the bootloader '''
-            BinFileSentBytes = BinFileSentBytes + BinFileReadLength
-            
-            ''' Calculate the remaining payload '''
-            BinFileRemainingBytes = File_Total_Len - BinFileSentBytes
-            print("\n   Bytes sent to the bootloader :{0}".format(BinFileSentBytes))
-            
-            ''' Read the response from the bootloader '''
-            BL_Return_Value = Read_Data_From_Serial_Port(CBL_MEM_WRITE_CMD)
-            sleep(0.1)
+        ''' Send an empty packet to get the status of the last programmed packets '''
+        CBL_MEM_WRITE_CMD_Len = 11
+        BL_Host_Buffer[0] = CBL_MEM_WRITE_CMD_Len - 1
+        BL_Host_Buffer[1] = CBL_MEM_WRITE_CMD
+        BL_Host_Buffer[2] = Word_Value_To_Byte_Value(BaseMemoryAddress, 1, 1)
+        BL_Host_Buffer[3] = Word_Value_To_Byte_Value(BaseMemoryAddress, 2, 1)
+        BL_Host_Buffer[4] = Word_Value_To_Byte_Value(BaseMemoryAddress, 3, 1)
+        BL_Host_Buffer[5] = Word_Value_To_Byte_Value(BaseMemoryAddress, 4, 1)
+        BL_Host_Buffer[6] = 0
+        CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_MEM_WRITE_CMD_Len - 4)
+        CRC32_Value = CRC32_Value & 0xFFFFFFFF
+        BL_Host_Buffer[7] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
+        BL_Host_Buffer[8] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
+        BL_Host_Buffer[9] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
+        BL_Host_Buffer[10] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_MEM_WRITE_CMD_Len)
+        Read_Data_From_Serial_Port(CBL_MEM_WRITE_CMD)
         ''' Memory write is inactive '''
         Memory_Write_Is_Active = 0
+        if(Memory_Write_All == 1):
+            Verify_Image_End(BinFile_Data, BaseMemoryAddress)
         if(Memory_Write_All == 1):
             print("\n\n Payload Written Successfully")
+    elif (Command == 17):
+        print("Delta update of the installed application command")
+        Memory_Write_All = 1
+        Installed_File = input("\n   Enter the installed binary file (empty for Installed.bin) : ")
+        if(Installed_File == ""):
+            Installed_File = "Installed.bin"
+        with open(Installed_File, 'rb') as Old_File:
+            Old_Image = Old_File.read()
+        OpenBinFile()
+        New_Image = Add_Image_Trailer(BinFile.read(), APP_BASE_ADDRESS)
+        BinFile.close()
+        if(len(Old_Image) > APP_MAX_SIZE or len(New_Image) > APP_MAX_SIZE):
+            print("\n   Error !! The image doesn't fit the application area")
+            return
+        Patch = Delta_Generate(Old_Image, New_Image)
+        print("   Patch of (", len(Patch), ") Bytes for a new image of (", len(New_Image), ") Bytes")
+        ''' The bootloader checks the installed image CRC before it touches the flash '''
+        CBL_DELTA_START_CMD_Len = 22
+        BL_Host_Buffer[0] = CBL_DELTA_START_CMD_Len - 1
+        BL_Host_Buffer[1] = CBL_DELTA_START_CMD
+        BL_Host_Buffer[2 : 18] = struct.pack('<IIII', len(Old_Image), Calculate_CRC32(Old_Image, len(Old_Image)) & 0xFFFFFFFF,
+                                             len(New_Image), Calculate_CRC32(New_Image, len(New_Image)) & 0xFFFFFFFF)
+        CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_DELTA_START_CMD_Len - 4)
+        CRC32_Value = CRC32_Value & 0xFFFFFFFF
+        BL_Host_Buffer[18] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
+        BL_Host_Buffer[19] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
+        BL_Host_Buffer[20] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
+        BL_Host_Buffer[21] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_DELTA_START_CMD_Len)
+        Read_Data_From_Serial_Port(CBL_DELTA_START_CMD)
+        if(Memory_Write_All == 0):
+            return
+        for Offset in range(0, len(Patch), WRITE_PAYLOAD_SIZE):
+            Write_Frame_To_Serial_Port(Build_Delta_Data_Frame(Patch[Offset : Offset + WRITE_PAYLOAD_SIZE]))
+            Read_Data_From_Serial_Port(CBL_DELTA_DATA_CMD)
+        ''' Send an empty packet to end the patch, the bootloader checks the CRC of the new image '''
+        Write_Frame_To_Serial_Port(Build_Delta_Data_Frame([]))
+        Read_Data_From_Serial_Port(CBL_DELTA_DATA_CMD)
+        if(Memory_Write_All == 1):
+            print("\n\n Delta Update Done, the new image is installed")
+    elif (Command == 18):
+        print("Fill a flash range with a pattern command")
+        Fill_Address = int(input("\n   Enter the start address : "), 16)
+        Fill_Length = int(input("   Enter the length in bytes (hex) : "), 16)
+        Fill_Pattern_Size = int(input("   Enter the pattern size (2 or 4 bytes) : "))
+        Fill_Pattern = int(input("   Enter the pattern (hex) : "), 16)
+        CBL_MEM_FILL_CMD_Len = 19
+        BL_Host_Buffer[0] = CBL_MEM_FILL_CMD_Len - 1
+        BL_Host_Buffer[1] = CBL_MEM_FILL_CMD
+        BL_Host_Buffer[2 : 15] = struct.pack('<IIBI', Fill_Address, Fill_Length, Fill_Pattern_Size, Fill_Pattern & 0xFFFFFFFF)
+        CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_MEM_FILL_CMD_Len - 4)
+        CRC32_Value = CRC32_Value & 0xFFFFFFFF
+        BL_Host_Buffer[15] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
+        BL_Host_Buffer[16] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
+        BL_Host_Buffer[17] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
+        BL_Host_Buffer[18] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_MEM_FILL_CMD_Len)
+        Read_Data_From_Serial_Port(CBL_MEM_FILL_CMD)
+    elif (Command == 19):
+        print("Run a batch of commands in one frame command")
+        Batch_Codes = input("\n   Enter the command codes in order (1-6, 15, 21), Ex: 1,3,4,6,5 : ")
+        Batch_Body = [CBL_BATCH_CMD, 0]
+        Batch_Commands = []
+        for Code in Batch_Codes.split(','):
+            Sub_Command = Build_Batch_Sub_Command(int(Code))
+            if(Sub_Command is None):
+                print("\n   Command", Code.strip(), "can't run inside a batch")
+                return
+            Batch_Body.extend([len(Sub_Command)] + Sub_Command)
+            Batch_Commands.append(Sub_Command[0])
+        if(input("   Stop at the first failed command (y/n) : ") == 'y'):
+            Batch_Body[1] = BATCH_STOP_ON_ERROR
+        Write_Frame_To_Serial_Port(Build_Extended_Frame(Batch_Body))
+        BL_Reply = Read_Reply_Frame()
+        if(BL_Reply is None):
+            print("\n   Timeout !!, Bootloader reply is missing or corrupted")
+        elif(BL_Reply[0] == CBL_SEND_ACK):
+            Process_CBL_BATCH_CMD(Batch_Commands, BL_Reply[1])
+        else:
+            print("\n   Received Not-Acknowledgement from Bootloader")
+    elif (Command == 20):
+        global Requested_CRC_Mode
+        print("Change the CRC mode of the frames command")
+        Requested_CRC_Mode = int(input("\n   Please Enter the CRC mode (1 : byte per word, 2 : word per word) : "))
+        CBL_SET_CRC_MODE_CMD_Len = 7
+        BL_Host_Buffer[0] = CBL_SET_CRC_MODE_CMD_Len - 1
+        BL_Host_Buffer[1] = CBL_SET_CRC_MODE_CMD
+        BL_Host_Buffer[2] = Requested_CRC_Mode
+        CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_SET_CRC_MODE_CMD_Len - 4)
+        CRC32_Value = CRC32_Value & 0xFFFFFFFF
+        BL_Host_Buffer[3] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
+        BL_Host_Buffer[4] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
+        BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
+        BL_Host_Buffer[6] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_SET_CRC_MODE_CMD_Len)
+        Read_Data_From_Serial_Port(CBL_SET_CRC_MODE_CMD)
+    elif (Command == 21):
+        global Expected_Region_CRC
+        print("Verify the flash against the binary file command")
+        OpenBinFile()
+        BinFile_Data = BinFile.read()
+        BinFile.close()
+        BaseMemoryAddress = int(input("\n   Enter the start address : "), 16)
+        ''' The trailer written with an application image is checked too, the bootloader uses the link CRC mode '''
+        BinFile_Data = Add_Image_Trailer(BinFile_Data, BaseMemoryAddress)
+        Expected_Region_CRC = Calculate_CRC32(BinFile_Data, len(BinFile_Data)) & 0xFFFFFFFF
+        CBL_REGION_CRC_CMD_Len = 14
+        BL_Host_Buffer[0] = CBL_REGION_CRC_CMD_Len - 1
+        BL_Host_Buffer[1] = CBL_REGION_CRC_CMD
+        BL_Host_Buffer[2 : 10] = struct.pack('<II', BaseMemoryAddress, len(BinFile_Data))
+        CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_REGION_CRC_CMD_Len - 4)
+        CRC32_Value = CRC32_Value & 0xFFFFFFFF
+        BL_Host_Buffer[10] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
+        BL_Host_Buffer[11] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
+        BL_Host_Buffer[12] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
+        BL_Host_Buffer[13] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_REGION_CRC_CMD_Len)
+        Read_Data_From_Serial_Port(CBL_REGION_CRC_CMD)
+        Expected_Region_CRC = None
+    elif (Command == 22):
+        print("Rewrite only the changed pages of the application command")
+        Memory_Write_All = 1
+        OpenBinFile()
+        BinFile_Data = Add_Image_Trailer(BinFile.read(), APP_BASE_ADDRESS)
+        BinFile.close()
+        if(len(BinFile_Data) > APP_MAX_SIZE):
+            print("\n   Error !! The image doesn't fit the application area")
+            return
+        ''' The flash after the image end is erased, so compare whole pages padded with 0xFF '''
+        Pages_Number = (len(BinFile_Data) + FLASH_PAGE_SIZE - 1) // FLASH_PAGE_SIZE
+        BinFile_Data = BinFile_Data + b'\xff' * (Pages_Number * FLASH_PAGE_SIZE - len(BinFile_Data))
+        Page_Runs = Changed_Page_Runs(BinFile_Data)
+        if(Page_Runs is None):
+            return
+        print("   (", sum(Run[1] for Run in Page_Runs), ") of (", Pages_Number, ") pages changed")
+        for First_Page, Run_Pages in Page_Runs:
+            Write_Frame_To_Serial_Port(Build_Extended_Frame([CBL_PAGE_ERASE_CMD] + list(struct.pack('<HH', First_Page, Run_Pages))))
+            Read_Data_From_Serial_Port(CBL_PAGE_ERASE_CMD)
+            if(Memory_Write_All == 0):
+                return
+            Run_Offset = First_Page * FLASH_PAGE_SIZE
+            for Extent_Offset, Extent_Data in Image_Extents(BinFile_Data[Run_Offset : Run_Offset + Run_Pages * FLASH_PAGE_SIZE]):
+                for Offset in range(0, len(Extent_Data), WRITE_PAYLOAD_SIZE):
+                    Write_Frame_To_Serial_Port(Build_Write_Frame(APP_BASE_ADDRESS + Run_Offset + Extent_Offset + Offset, Extent_Data[Offset : Offset + WRITE_PAYLOAD_SIZE]))
+                    Read_Data_From_Serial_Port(CBL_MEM_WRITE_CMD)
+        ''' Send an empty packet to get the status of the last programmed packets '''
+        Write_Frame_To_Serial_Port(Build_Write_Frame(APP_BASE_ADDRESS, []))
+        Read_Data_From_Serial_Port(CBL_MEM_WRITE_CMD)
+        if(Memory_Write_All == 1 and len(Page_Runs)):
+            Verify_Image_End(BinFile_Data, APP_BASE_ADDRESS)
+        if(Memory_Write_All == 1):
+            print("\n\n Changed Pages Written Successfully")
     elif (Command == 12):
         print("Change read protection level of the user flash command")
         Protection_level = input("\n   Please Enter one of these Protection levels : 0,1 : ")
@@ -438,17 +1342,102 @@ def Decode_CBL_Command(Command):
             BL_Host_Buffer[4] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
             BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
             BL_Host_Buffer[6] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
-            Write_Data_To_Serial_Port(BL_Host_Buffer[0], 1)
-            for Data in BL_Host_Buffer[1 : CBL_CHANGE_ROP_Level_CMD_Len]:
-                Write_Data_To_Serial_Port(Data, CBL_CHANGE_ROP_Level_CMD_Len - 1)
+            Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_CHANGE_ROP_Level_CMD_Len)
             Read_Data_From_Serial_Port(CBL_CHANGE_ROP_Level_CMD)
         else:
             print("\n   Protection level (", Protection_level, ") not supported !!")
+    elif (Command == 13):
+        print("Write data into the MCU flash with the sliding window command")
+        print("   Preparing writing a binary file with length (", CalulateBinFileLength(), ") Bytes")
+        OpenBinFile()
+        BaseMemoryAddress = input("\n   Enter the start address : ")
+        BaseMemoryAddress = int(BaseMemoryAddress, 16)
+        if(Memory_Write_Windowed(BaseMemoryAddress, WRITE_WINDOW_SIZE)):
+            print("\n\n Payload Written Successfully")
+        BinFile.close()
+    elif (Command == 14):
+        global Requested_Baud_Rate
+        print("Change the baud rate of the bootloader link command")
+        print("\n   Supported baud rates : ", BL_SUPPORTED_BAUD_RATES)
+        Requested_Baud_Rate = int(input("\n   Please Enter the Baud Rate : "))
+        CBL_CHANGE_BAUD_CMD_Len = 10
+        BL_Host_Buffer[0] = CBL_CHANGE_BAUD_CMD_Len - 1
+        BL_Host_Buffer[1] = CBL_CHANGE_BAUD_CMD
+        BL_Host_Buffer[2] = Word_Value_To_Byte_Value(Requested_Baud_Rate, 1, 1)
+        BL_Host_Buffer[3] = Word_Value_To_Byte_Value(Requested_Baud_Rate, 2, 1)
+        BL_Host_Buffer[4] = Word_Value_To_Byte_Value(Requested_Baud_Rate, 3, 1)
+        BL_Host_Buffer[5] = Word_Value_To_Byte_Value(Requested_Baud_Rate, 4, 1)
+        CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_CHANGE_BAUD_CMD_Len - 4)
+        CRC32_Value = CRC32_Value & 0xFFFFFFFF
+        BL_Host_Buffer[6] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
+        BL_Host_Buffer[7] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
+        BL_Host_Buffer[8] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
+        BL_Host_Buffer[9] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_CHANGE_BAUD_CMD_Len)
+        Read_Data_From_Serial_Port(CBL_CHANGE_BAUD_CMD)
+    elif (Command == 15):
+        print("Read the bootloader link statistics command")
+        CBL_GET_LINK_STATS_CMD_Len = 6
+        BL_Host_Buffer[0] = CBL_GET_LINK_STATS_CMD_Len - 1
+        BL_Host_Buffer[1] = CBL_GET_LINK_STATS_CMD
+        CRC32_Value = Calculate_CRC32(BL_Host_Buffer, CBL_GET_LINK_STATS_CMD_Len - 4)
+        CRC32_Value = CRC32_Value & 0xFFFFFFFF
+        BL_Host_Buffer[2] = Word_Value_To_Byte_Value(CRC32_Value, 1, 1)
+        BL_Host_Buffer[3] = Word_Value_To_Byte_Value(CRC32_Value, 2, 1)
+        BL_Host_Buffer[4] = Word_Value_To_Byte_Value(CRC32_Value, 3, 1)
+        BL_Host_Buffer[5] = Word_Value_To_Byte_Value(CRC32_Value, 4, 1)
+        Write_Command_To_Serial_Port(BL_Host_Buffer, CBL_GET_LINK_STATS_CMD_Len)
+        Read_Data_From_Serial_Port(CBL_GET_LINK_STATS_CMD)
+    elif (Command == 16):
+        print("Write a compressed binary file to the flash command")
+        Memory_Write_All = 1
+        OpenBinFile()
+        BinFile_Data = BinFile.read()
+        BinFile.close()
+        BaseMemoryAddress = int(input("\n   Enter the start address : "), 16)
+        BinFile_Data = Add_Image_Trailer(BinFile_Data, BaseMemoryAddress)
+        ''' The bootloader decompresses the stream on the fly, every frame carries the image start address '''
+        Compressed_Data = LZ_Compress(BinFile_Data)
+        print("   Binary file (", len(BinFile_Data), ") Bytes compressed to (", len(Compressed_Data), ") Bytes")
+        for Offset in range(0, len(Compressed_Data), WRITE_PAYLOAD_SIZE):
+            Write_Frame_To_Serial_Port(Build_Write_Compressed_Frame(BaseMemoryAddress, Compressed_Data[Offset : Offset + WRITE_PAYLOAD_SIZE]))
+            print("\n   Compressed bytes sent to the bootloader :{0}".format(min(Offset + WRITE_PAYLOAD_SIZE, len(Compressed_Data))))
+            Read_Data_From_Serial_Port(CBL_MEM_WRITE_COMPRESSED_CMD)
+        ''' Send an empty packet to close the stream and get the status of the whole image '''
+        Write_Frame_To_Serial_Port(Build_Write_Compressed_Frame(BaseMemoryAddress, []))
+        Read_Data_From_Serial_Port(CBL_MEM_WRITE_COMPRESSED_CMD)
+        if(Memory_Write_All == 1):
+            Verify_Image_End(BinFile_Data, BaseMemoryAddress)
+        if(Memory_Write_All == 1):
+            print("\n\n Payload Written Successfully")
             
         
 
-SerialPortName = input("Enter the Port Name of your device(Ex: COM3):")
-Serial_Port_Configuration(SerialPortName)
+''' python Host.py --export-key <key.pem> > bootloader_key.c : the public key for the BL
+    python Host.py --key <key.pem> : sign the application images with this key '''
+if(len(sys.argv) > 1 and sys.argv[1] in ('--export-key', '--key')):
+    if(len(sys.argv) < 3):
+        print("Error !! No signing key given, use : python Host.py", sys.argv[1], "<key.pem>", file = sys.stderr)
+        sys.exit(1)
+    Signing_Key = Load_Signing_Key(sys.argv[2])
+    if(Signing_Key is None):
+        sys.exit(1)
+    if(sys.argv[1] == '--export-key'):
+        Export_Public_Key(sys.argv[2], Signing_Key)
+        sys.exit(0)
+
+SerialPortName = input("Enter the Port Name of your device(Ex: COM3, /dev/pts/3 for a native build, or can0 / vcan0 for CAN):")
+if(SerialPortName.startswith(CAN_INTERFACE_PREFIXES)):
+    ''' The CAN bit rate is set on the interface and the bootloader has no auto baud on CAN '''
+    CAN_Port_Configuration(SerialPortName)
+else:
+    SerialBaudRate = input("Enter the Baud Rate (Ex: 921600, empty for 115200):")
+    if(not SerialBaudRate.isdigit()):
+        SerialBaudRate = BL_DEFAULT_BAUD_RATE
+    if(Serial_Port_Configuration(SerialPortName, int(SerialBaudRate)) != -1):
+        Auto_Baud_Sync()
+if(input("Use COBS framing (y/n):") == 'y'):
+    Framing_Mode = FRAMING_COBS
         
 while True:
     print("\nSTM32F103 Custome BootLoader")
@@ -466,6 +1455,16 @@ while True:
     print("   CBL_READ_SECTOR_STATUS_CMD   --> 10")
     print("   CBL_OTP_READ_CMD             --> 11")
     print("   CBL_CHANGE_ROP_Level_CMD     --> 12")
+    print("   CBL_MEM_WRITE_WINDOW_CMD     --> 13")
+    print("   CBL_CHANGE_BAUD_CMD          --> 14")
+    print("   CBL_GET_LINK_STATS_CMD       --> 15")
+    print("   CBL_MEM_WRITE_COMPRESSED_CMD --> 16")
+    print("   CBL_DELTA_UPDATE_CMD         --> 17")
+    print("   CBL_MEM_FILL_CMD             --> 18")
+    print("   CBL_BATCH_CMD                --> 19")
+    print("   CBL_SET_CRC_MODE_CMD         --> 20")
+    print("   CBL_REGION_CRC_CMD           --> 21")
+    print("   CBL_PAGE_DIFF_UPDATE_CMD     --> 22")
     
     CBL_Command = input("\nEnter the command code : ")
     
@@ -10,19 +10,77 @@
 *******************************************************************************/
 #include <stdint.h>
 #include "bootloader.h"
-#include "bootloader_private.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
 #include "usart.h"
 #include "crc.h"
+#include "dma.h"
+#include "bootloader_transport.h"
+#include "bootloader_signature.h"
+#include "bootloader_private.h"
 
 /*******************************************************************************
 *                           Global Variables                                  *
 *******************************************************************************/
 static uint8_t BL_HOST_Buffer[BL_HOST_BUFFER_SIZE];
+/* Received packet length including the length byte (v2 frames: the marker only) */
+static uint16_t BL_Host_Packet_Len = 0;
+
+/* Link to the host, it keeps the received bytes till the parser reads them */
+static const BL_Transport *BL_Host_Transport = &BL_HOST_TRANSPORT;
+
+/* Incremental parser of the host frames, fed from the ring by the fetch */
+static BL_Host_Parser BL_Parser;
+
+/* Ping-pong buffers, one is programmed while the other receives the next packet */
+static BL_Write_Buffer BL_Write_Buffers[BL_WRITE_BUFFERS_NUMBER];
+static uint8_t BL_Write_Fill_Index = 0;
+static uint8_t BL_Write_Program_Index = 0;
+static uint8_t BL_Write_Pending = 0;
+static uint8_t BL_Write_Status = FLASH_WRITE_PASSED;
+
+/* Sliding window write session */
+static uint8_t BL_Window_Size = BL_WINDOW_CLOSED;
+static uint16_t BL_Window_Expected_Seq = 0;
+static uint8_t BL_Window_Unacked = 0;
+static uint8_t BL_Window_Nack_Sent = 0;
+static uint8_t BL_Window_Close_Status = FLASH_WRITE_PASSED;
+
+/* Compressed write stream */
+static BL_LZ_Decoder BL_LZ;
+
+/* Delta update session */
+static BL_Delta_Patch BL_Delta;
 
-uint8_t BL_Supported_Commands[12] =
+/* Replies of the batch being executed */
+static BL_Batch_Reply BL_Batch;
+
+/* Host framing, the resync counter counts the dropped frames and stray bytes
+ * and the timeout counter the frames the host did not finish */
+static uint8_t BL_Framing_Mode = BL_FRAMING_RAW;
+static uint32_t BL_Framing_Resyncs = 0;
+static uint32_t BL_Framing_Timeouts = 0;
+
+/* CRC of the frames, the replies and the image checks, v1 till the host asks for v2 */
+static uint8_t BL_CRC_Mode = BL_CRC_MODE_V1;
+
+/* Last record of the metadata page */
+static BL_Meta_State BL_Meta;
+/* Set by a change of the application area, the end of a write session checks the image */
+static uint8_t BL_App_Written = 0;
+#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+/* Time of the last signature check in us, from the DWT cycle counter */
+static uint32_t BL_Verify_Time_us = 0;
+#endif
+
+/* Running CRC of the written application image */
+static BL_Image_Hash_State BL_Image_Hash;
+
+/* Speed found by the link sync, the baud rate command falls back to it */
+static uint32_t BL_Host_Baud_Rate = BL_DEFAULT_BAUD_RATE;
+
+uint8_t BL_Supported_Commands[] =
 {
 	CBL_GET_VER_CMD,
 	CBL_GET_HELP_CMD,
@@ -35,114 +93,132 @@ uint8_t BL_Supported_Commands[12] =
 	CBL_MEM_READ_CMD,
 	CBL_READ_SECTOR_STATUS_CMD,
 	CBL_OTP_READ_CMD,
-	CBL_CHANGE_ROP_LEVEL_CMD
+	CBL_CHANGE_ROP_LEVEL_CMD,
+	CBL_MEM_WRITE_WINDOW_CMD,
+	CBL_MEM_WRITE_SEQ_CMD,
+	CBL_CHANGE_BAUD_CMD,
+	CBL_GET_LINK_STATS_CMD,
+	CBL_MEM_WRITE_COMPRESSED_CMD,
+	CBL_DELTA_START_CMD,
+	CBL_DELTA_DATA_CMD,
+	CBL_MEM_FILL_CMD,
+	CBL_BATCH_CMD,
+	CBL_SET_CRC_MODE_CMD,
+	CBL_REGION_CRC_CMD,
+	CBL_PAGE_CRC_CMD,
+	CBL_PAGE_ERASE_CMD,
+	CBL_IMAGE_END_CMD
+};
+
+/* Commands that can run inside a batch, the others need their own exchange with the host */
+static const BL_Batch_Command BL_Batch_Commands[] =
+{
+	{CBL_GET_VER_CMD,					4},
+	{CBL_GET_HELP_CMD,				sizeof(BL_Supported_Commands)},
+	{CBL_GET_CID_CMD,					2},
+	{CBL_GET_RDP_STATUS_CMD,	1},
+	{CBL_GO_TO_ADDR_CMD,			1},
+	{CBL_FLASH_ERASE_CMD,			1},
+	{CBL_MEM_WRITE_CMD,				BL_WRITE_END_REPLY_LEN},
+	{CBL_GET_LINK_STATS_CMD,	8},
+	{CBL_MEM_FILL_CMD,				1},
+	{CBL_REGION_CRC_CMD,			CRC_BYTE_SIZE},
+	{CBL_IMAGE_END_CMD,				BL_IMAGE_END_REPLY_LEN}
+};
+
+/* Speeds the host can move the link to, USART1 runs from the 72 MHz PCLK2 */
+static const uint32_t BL_Supported_Baud_Rates[] =
+{
+	BL_DEFAULT_BAUD_RATE,
+	460800,
+	921600,
+	2000000
 };
 /*******************************************************************************
 *                      Functions Definitions                                   *
 *******************************************************************************/
 
+/*******************************************************************************
+* Function Name:		BL_Init
+********************************************************************************/
+void BL_Init(void)
+{
+	BL_Host_Transport->Init();
+	/* Cycle counter for the signature check time */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	#ifdef BL_ENABLE_APP_IMAGE_CHECK
+	/* A new image pays its full CRC here once, the next boots only read the metadata page.
+	 * Nothing jumps on this result : the BL waits for the host after reset and the application
+	 * only runs through the jump command, which checks the image again before it leaves */
+	if(BL_APP_IMAGE_VALID == BL_App_Image_Check())
+	{
+		BL_Print_Message("Application Image Valid \r\n");
+	}
+	else
+	{
+		BL_Print_Message("No Valid Application Image \r\n");
+	}
+	#endif
+}
+
+/*******************************************************************************
+* Function Name:		BL_Auto_Baud_Detect
+********************************************************************************/
+void BL_Auto_Baud_Detect(void)
+{
+	if(NULL != BL_Host_Transport->Sync)
+	{
+		BL_Host_Baud_Rate = BL_Host_Transport->Sync();
+		BL_Print_Message("Auto Baud Rate %d \r\n",BL_Host_Baud_Rate);
+		/* Tell the host the link is locked */
+		BL_Send_ACK_NACK(BL_OK,NULL,0);
+	}
+}
+
 /*******************************************************************************
 * Function Name:		BL_UART_Fetch_Host_command
 ********************************************************************************/
 BL_Status BL_UART_Fetch_Host_Command(void)
 {
 	BL_Status Status = BL_NACK;
-	uint8_t Data_Length = 0;
-	HAL_StatusTypeDef UART_Status = HAL_ERROR ;
-	
-	/* Clearing the host buffer so we can receive */
-	memset(BL_HOST_Buffer,0,BL_HOST_BUFFER_SIZE);
-	/* Receive the command size from the host */
-	UART_Status = HAL_UART_Receive(BL_HOST_COMMUNICATION_UART,BL_HOST_Buffer,1,HAL_MAX_DELAY);
-	if(UART_Status == HAL_OK)
-	{
-		Data_Length = BL_HOST_Buffer[0];
-		/* Receive the whole command from the host */
-		UART_Status = HAL_UART_Receive(BL_HOST_COMMUNICATION_UART,BL_HOST_Buffer+1,Data_Length,HAL_MAX_DELAY);
-		Data_Length = BL_HOST_Buffer[0];
-		if(UART_Status == HAL_OK)
-		{
-			switch(BL_HOST_Buffer[1])
-			{
-				case CBL_GET_VER_CMD:
-					BL_Get_Version(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_GET_HELP_CMD:
-					BL_Get_Help(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_GET_CID_CMD:
-					BL_Get_Chip_ID(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_GET_RDP_STATUS_CMD:
-					BL_Get_Read_Protection_Level(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_GO_TO_ADDR_CMD:
-					BL_Jump_To_Address(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_FLASH_ERASE_CMD:
-					BL_Erase_Flash(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_MEM_WRITE_CMD:
-					BL_Memory_Write(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_EN_R_W_PROTECT_CMD:
-					BL_Print_Message("Enable read/write protect on different sectors of the user flash \r\n");
-					BL_Enable_RW_Protection(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_MEM_READ_CMD:
-					BL_Print_Message("Read data from different memories of the MCU \r\n");
-					BL_Memory_Read(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_READ_SECTOR_STATUS_CMD:
-					BL_Print_Message("Read all the sector protection status \r\n");
-					BL_Get_Sector_Protection_Status(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_OTP_READ_CMD:
-					BL_Print_Message("Read the OTP Content \r\n");
-					BL_Read_OTP(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				case CBL_CHANGE_ROP_LEVEL_CMD:
-					BL_Change_Read_Protection_Level(BL_HOST_Buffer);
-					Status = BL_OK;
-					break;
-				
-				default:
-					BL_Print_Message("Invalid command code received from the host !!\r\n");
-				
-					Status = BL_NACK;
-					break;
-			}
+	uint8_t Data = 0;
+	BL_Frame_Status Frame_Status = BL_FRAME_PENDING;
+	
+	/* Feed the parser with what the DMA brought so far, nothing here waits for the host */
+	while((BL_FRAME_PENDING == Frame_Status) && (BL_Host_Rx_Available() > 0))
+	{
+		BL_Receive_Data_From_Host(&Data,1,HAL_MAX_DELAY);
+		Frame_Status = BL_Parser_Feed(Data);
+	}
+	if(BL_FRAME_PENDING == Frame_Status)
+	{
+		Frame_Status = BL_Parser_Check_Timeout();
+	}
+	
+	if(BL_FRAME_TIMEOUT == Frame_Status)
+	{
+		/* The host stopped in the middle of a frame */
+		BL_Framing_Timeouts++;
+		if(BL_WINDOW_CLOSED != BL_Window_Size)
+		{
+			BL_Window_Report_Missing();
 		}
 		else
 		{
-			Status = BL_NACK;
+			BL_Send_ACK_NACK(BL_NACK,NULL,0);
 		}
 	}
-	else
+	else if(BL_FRAME_PENDING == Frame_Status)
+	{
+		/* Keep programming the previous write packets while the host is quiet */
+		BL_Write_Pipeline_Service();
+	}
+	
+	if(BL_FRAME_READY == Frame_Status)
 	{
-		Status = BL_NACK;
+		Status = BL_Execute_Command(BL_HOST_Buffer);
 	}
 	
 	return Status;
@@ -152,6 +228,165 @@ BL_Status BL_UART_Fetch_Host_Command(void)
 *                      Private Functions Definitions                           *
 *******************************************************************************/
 
+/*******************************************************************************
+* Function Name:		BL_Execute_Command
+********************************************************************************/
+static BL_Status BL_Execute_Command(uint8_t *Hostbuffer)
+{
+	BL_Status Status = BL_NACK;
+	
+	/* Only the write commands can run while the flash is still programmed */
+	if((CBL_MEM_WRITE_CMD != Hostbuffer[1]) && (CBL_MEM_WRITE_SEQ_CMD != Hostbuffer[1])
+		&& (CBL_MEM_WRITE_COMPRESSED_CMD != Hostbuffer[1]) && (CBL_DELTA_DATA_CMD != Hostbuffer[1]))
+	{
+		BL_Write_Pipeline_Flush();
+	}
+	switch(Hostbuffer[1])
+	{
+		case CBL_GET_VER_CMD:
+			BL_Get_Version(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_GET_HELP_CMD:
+			BL_Get_Help(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_GET_CID_CMD:
+			BL_Get_Chip_ID(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_GET_RDP_STATUS_CMD:
+			BL_Get_Read_Protection_Level(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_GO_TO_ADDR_CMD:
+			BL_Jump_To_Address(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_FLASH_ERASE_CMD:
+			BL_Erase_Flash(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_MEM_WRITE_CMD:
+			BL_Memory_Write(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_EN_R_W_PROTECT_CMD:
+			BL_Print_Message("Enable read/write protect on different sectors of the user flash \r\n");
+			BL_Enable_RW_Protection(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_MEM_READ_CMD:
+			BL_Print_Message("Read data from different memories of the MCU \r\n");
+			BL_Memory_Read(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_READ_SECTOR_STATUS_CMD:
+			BL_Print_Message("Read all the sector protection status \r\n");
+			BL_Get_Sector_Protection_Status(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_OTP_READ_CMD:
+			BL_Print_Message("Read the OTP Content \r\n");
+			BL_Read_OTP(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_CHANGE_ROP_LEVEL_CMD:
+			BL_Change_Read_Protection_Level(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_MEM_WRITE_WINDOW_CMD:
+			BL_Memory_Write_Window_Start(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_MEM_WRITE_SEQ_CMD:
+			BL_Memory_Write_Sequenced(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_CHANGE_BAUD_CMD:
+			BL_Change_Baud_Rate(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_GET_LINK_STATS_CMD:
+			BL_Get_Link_Stats(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_MEM_WRITE_COMPRESSED_CMD:
+			BL_Memory_Write_Compressed(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_DELTA_START_CMD:
+			BL_Delta_Start(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_DELTA_DATA_CMD:
+			BL_Delta_Data(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_MEM_FILL_CMD:
+			BL_Memory_Fill(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_BATCH_CMD:
+			BL_Batch_Execute(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_SET_CRC_MODE_CMD:
+			BL_Set_CRC_Mode(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_REGION_CRC_CMD:
+			BL_Region_CRC(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_PAGE_CRC_CMD:
+			BL_Page_CRC(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_PAGE_ERASE_CMD:
+			BL_Page_Erase(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		case CBL_IMAGE_END_CMD:
+			BL_Image_End(Hostbuffer);
+			Status = BL_OK;
+			break;
+		
+		default:
+			BL_Print_Message("Invalid command code received from the host !!\r\n");
+		
+			Status = BL_NACK;
+			break;
+	}
+	
+	return Status;
+}
+
 /*******************************************************************************
 * Function Name:		BL_Print_Message
 ********************************************************************************/
@@ -159,44 +394,297 @@ void BL_Print_Message(char*format,...)
 {
 	char Message[100] = {0};
 	va_list args;
+	/* A batch runs without the blocking debug messages */
+	if(BL_Batch.Active)
+	{
+		return;
+	}
 	va_start(args,format);
 	vsprintf(Message,format,args);
 	#ifdef BL_ENABLE_UART_DEBUG_MESSAGE
-	HAL_UART_Transmit(BL_DEBUG_UART, (uint8_t*)Message, sizeof(Message), HAL_MAX_DELAY);
+	HAL_UART_Transmit(BL_DEBUG_UART, (uint8_t*)Message, strlen(Message), HAL_MAX_DELAY);
 	#endif
 	va_end(args);
 }
 
 /*******************************************************************************
-* Function Name:		BL_Send_Data_To_Host
+* Function Name:		BL_Host_Rx_Available
 ********************************************************************************/
-static void BL_Send_Data_To_Host(uint8_t *Data_Buffer, uint32_t Data_Len)
+static uint16_t BL_Host_Rx_Available(void)
 {
-	HAL_UART_Transmit(BL_HOST_COMMUNICATION_UART,Data_Buffer,Data_Len,HAL_MAX_DELAY);
+	return BL_Host_Transport->Rx_Available();
 }
 
 /*******************************************************************************
-* Function Name:		BL_Send_ACK_NACK
+* Function Name:		BL_Receive_Data_From_Host
+********************************************************************************/
+static HAL_StatusTypeDef BL_Receive_Data_From_Host(uint8_t *Data_Buffer, uint16_t Data_Len, uint32_t Timeout)
+{
+	uint32_t Start_Tick = HAL_GetTick();
+	
+	if(Data_Len >= BL_HOST_RX_RING_SIZE)
+	{
+		return HAL_ERROR;
+	}
+	/* Wait till the link brings the required bytes and keep
+	 * programming the previous write packets meanwhile */
+	while(BL_Host_Rx_Available() < Data_Len)
+	{
+		BL_Write_Pipeline_Service();
+		if((HAL_MAX_DELAY != Timeout) && ((HAL_GetTick() - Start_Tick) > Timeout))
+		{
+			return HAL_TIMEOUT;
+		}
+	}
+	BL_Host_Transport->Rx_Read(Data_Buffer,Data_Len);
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Reset
+********************************************************************************/
+static void BL_Parser_Reset(BL_Parser_State State)
+{
+	BL_Parser.State = State;
+	BL_Parser.Received = 0;
+	BL_Parser.Data_Length = 0;
+	BL_Parser.Length_Received = 0;
+	BL_Parser.COBS_Code = 0;
+	BL_Parser.COBS_Block_Left = 0;
+	BL_Parser.Frame_Start_Tick = HAL_GetTick();
+	BL_Parser.Last_Byte_Tick = BL_Parser.Frame_Start_Tick;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Feed
 ********************************************************************************/
-static void BL_Send_ACK_NACK(BL_Status BL_Message,uint8_t Reply_Len)
+static BL_Frame_Status BL_Parser_Feed(uint8_t Data)
 {
-	uint8_t ACK_Value[2] = {0,Reply_Len};
-	switch(BL_Message)
+	BL_Frame_Status Frame_Status = BL_FRAME_PENDING;
+	
+	BL_Parser.Last_Byte_Tick = HAL_GetTick();
+	switch(BL_Parser.State)
 	{
-		case BL_OK:
-			ACK_Value[0] = CBL_SEND_ACK ;
-			BL_Send_Data_To_Host(ACK_Value,2);
+		case BL_PARSER_IDLE:
+			/* Clearing the host buffer so we can receive */
+			memset(BL_HOST_Buffer,0,BL_HOST_BUFFER_SIZE);
+			BL_Parser_Reset(BL_PARSER_IDLE);
+			BL_HOST_Buffer[0] = Data;
+			if(BL_FRAME_COBS_DELIMITER == Data)
+			{
+				BL_Parser.State = BL_PARSER_COBS_DATA;
+			}
+			else if(BL_FRAMING_COBS == BL_Framing_Mode)
+			{
+				/* Bytes outside a frame, hunt for the next delimiter */
+				BL_Framing_Resyncs++;
+				BL_Parser.State = BL_PARSER_COBS_HUNT;
+			}
+			else if(BL_FRAME_V2_MARKER == Data)
+			{
+				/* Extended frame, the 16 bit length follows the marker and the command
+				 * is stored right after the marker so the handlers see the v1 layout */
+				BL_Parser.Received = 1;
+				BL_Parser.State = BL_PARSER_V2_LENGTH;
+			}
+			else
+			{
+				BL_Parser.Received = 1;
+				BL_Parser.Data_Length = Data;
+				BL_Parser.State = BL_PARSER_BODY;
+				Frame_Status = BL_Parser_Check_Length();
+			}
+			break;
+		
+		case BL_PARSER_V2_LENGTH:
+			/* Low byte first */
+			BL_Parser.Data_Length |= (uint16_t)(Data << (8 * BL_Parser.Length_Received));
+			BL_Parser.Length_Received++;
+			if(BL_FRAME_V2_LENGTH_SIZE == BL_Parser.Length_Received)
+			{
+				BL_Parser.State = BL_PARSER_BODY;
+				Frame_Status = BL_Parser_Check_Length();
+			}
+			break;
+		
+		case BL_PARSER_BODY:
+			BL_HOST_Buffer[BL_Parser.Received++] = Data;
+			if(BL_Parser.Received == (BL_Parser.Data_Length + 1))
+			{
+				Frame_Status = BL_FRAME_READY;
+			}
+			break;
+		
+		case BL_PARSER_COBS_HUNT:
+			if(BL_FRAME_COBS_DELIMITER == Data)
+			{
+				BL_Parser_Reset(BL_PARSER_COBS_DATA);
+			}
 			break;
 		
-		case BL_NACK:
-			ACK_Value[0] = CBL_SEND_NACK ;
-			BL_Send_Data_To_Host(ACK_Value,1);
+		case BL_PARSER_COBS_DATA:
+			Frame_Status = BL_Parser_COBS_Decode(Data);
 			break;
 		
 		default:
+			BL_Parser_Reset(BL_PARSER_IDLE);
 			break;
 	}
 	
+	if(BL_FRAME_READY == Frame_Status)
+	{
+		BL_Host_Packet_Len = BL_Parser.Data_Length + 1;
+	}
+	if(BL_FRAME_PENDING != Frame_Status)
+	{
+		BL_Parser.State = BL_PARSER_IDLE;
+	}
+	return Frame_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Check_Length
+********************************************************************************/
+static BL_Frame_Status BL_Parser_Check_Length(void)
+{
+	if((BL_Parser.Data_Length > CRC_BYTE_SIZE) && (BL_Parser.Data_Length < BL_HOST_BUFFER_SIZE))
+	{
+		return BL_FRAME_PENDING;
+	}
+	return BL_FRAME_DROPPED;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Parser_COBS_Decode
+********************************************************************************/
+static BL_Frame_Status BL_Parser_COBS_Decode(uint8_t Data)
+{
+	uint16_t Expected_Len = 0;
+	
+	if(BL_FRAME_COBS_DELIMITER == Data)
+	{
+		/* Back to back delimiters are empty frames */
+		if(0 == BL_Parser.COBS_Code)
+		{
+			BL_Parser_Reset(BL_PARSER_COBS_DATA);
+			return BL_FRAME_PENDING;
+		}
+		/* The frame must end with its last block and match the length it carries */
+		if((0 == BL_Parser.COBS_Block_Left) && (BL_Parser.Received > BL_FRAME_V2_HEADER_SIZE))
+		{
+			if(BL_FRAME_V2_MARKER == BL_HOST_Buffer[0])
+			{
+				BL_Parser.Data_Length = (uint16_t)(BL_HOST_Buffer[1] | (BL_HOST_Buffer[2] << 8));
+				Expected_Len = BL_Parser.Data_Length + BL_FRAME_V2_HEADER_SIZE;
+				/* Drop the length bytes as the raw frames do */
+				memmove(BL_HOST_Buffer+1,BL_HOST_Buffer+BL_FRAME_V2_HEADER_SIZE,
+					BL_Parser.Received-BL_FRAME_V2_HEADER_SIZE);
+			}
+			else
+			{
+				BL_Parser.Data_Length = BL_HOST_Buffer[0];
+				Expected_Len = BL_Parser.Data_Length + 1;
+			}
+		}
+		if((Expected_Len != BL_Parser.Received) || (BL_FRAME_DROPPED == BL_Parser_Check_Length()))
+		{
+			BL_Framing_Resyncs++;
+			return BL_FRAME_DROPPED;
+		}
+		BL_Framing_Mode = BL_FRAMING_COBS;
+		return BL_FRAME_READY;
+	}
+	
+	/* Each code byte gives the distance to the next zero of the frame and
+	 * the zero is written when the next block starts */
+	if(0 == BL_Parser.COBS_Block_Left)
+	{
+		if((0 != BL_Parser.COBS_Code) && (BL_COBS_MAX_CODE != BL_Parser.COBS_Code))
+		{
+			BL_Parser_COBS_Put_Byte(0);
+		}
+		BL_Parser.COBS_Code = Data;
+		BL_Parser.COBS_Block_Left = Data - 1;
+	}
+	else
+	{
+		BL_Parser_COBS_Put_Byte(Data);
+		BL_Parser.COBS_Block_Left--;
+	}
+	return BL_FRAME_PENDING;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Parser_COBS_Put_Byte
+********************************************************************************/
+static void BL_Parser_COBS_Put_Byte(uint8_t Data)
+{
+	if(BL_Parser.Received < BL_HOST_BUFFER_SIZE)
+	{
+		BL_HOST_Buffer[BL_Parser.Received++] = Data;
+	}
+	else
+	{
+		/* Too long for the host buffer, drop it at the closing delimiter */
+		BL_Framing_Resyncs++;
+		BL_Parser.State = BL_PARSER_COBS_HUNT;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Check_Timeout
+********************************************************************************/
+static BL_Frame_Status BL_Parser_Check_Timeout(void)
+{
+	uint32_t Tick = HAL_GetTick();
+	
+	/* Only a started frame can time out, the parser waits for the first byte or a
+	 * delimiter as long as the host wants */
+	if((BL_PARSER_V2_LENGTH != BL_Parser.State) && (BL_PARSER_BODY != BL_Parser.State)
+		&& !((BL_PARSER_COBS_DATA == BL_Parser.State) && (0 != BL_Parser.COBS_Code)))
+	{
+		return BL_FRAME_PENDING;
+	}
+	if(((Tick - BL_Parser.Last_Byte_Tick) > BL_Host_Transport->Byte_Timeout)
+		|| ((Tick - BL_Parser.Frame_Start_Tick) > BL_Host_Transport->Frame_Timeout))
+	{
+		BL_Parser.State = BL_PARSER_IDLE;
+		return BL_FRAME_TIMEOUT;
+	}
+	return BL_FRAME_PENDING;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Send_ACK_NACK
+********************************************************************************/
+static void BL_Send_ACK_NACK(BL_Status BL_Message, uint8_t *Reply, uint8_t Reply_Len)
+{
+	uint8_t Reply_Frame[BL_REPLY_HEADER_SIZE+BL_REPLY_MAX_LEN+CRC_BYTE_SIZE] = {CBL_SEND_NACK,0};
+	uint16_t Frame_Len = BL_REPLY_HEADER_SIZE;
+	
+	if(BL_Batch.Active)
+	{
+		BL_Batch_Capture(BL_Message,Reply,Reply_Len);
+		return;
+	}
+	if(BL_OK == BL_Message)
+	{
+		Reply_Frame[0] = CBL_SEND_ACK;
+	}
+	if(Reply_Len > BL_REPLY_MAX_LEN)
+	{
+		Reply_Len = BL_REPLY_MAX_LEN;
+	}
+	/* The whole reply is assembled here and goes to the DMA as one transfer */
+	Reply_Frame[1] = Reply_Len;
+	memcpy(Reply_Frame+BL_REPLY_HEADER_SIZE,Reply,Reply_Len);
+	Frame_Len += Reply_Len;
+	#ifdef BL_ENABLE_REPLY_CRC
+	uint32_t Reply_CRC = BL_CRC_Calculate(Reply_Frame,Frame_Len);
+	memcpy(Reply_Frame+Frame_Len,&Reply_CRC,CRC_BYTE_SIZE);
+	Frame_Len += CRC_BYTE_SIZE;
+	#endif
+	BL_Host_Transport->Send(Reply_Frame,Frame_Len);
 }
 
 /*******************************************************************************
@@ -208,20 +696,19 @@ static void BL_Get_Version(uint8_t *Hostbuffer)
 	
 	/* Get the CRC value and the length sent by the user */
 	uint8_t BL_Version[4] = {CBL_VERSION_ID,CBL_SW_MAJOR_VERSION,CBL_SW_MINORR_VERSION,CBL_SW_PATCH_VERSION};
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
 	/* CRC Verification */
 	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
 		BL_Print_Message("CRC Verification Passed \r\n");
-		BL_Send_ACK_NACK(BL_OK,4);
-		BL_Send_Data_To_Host(BL_Version,4);
+		BL_Send_ACK_NACK(BL_OK,BL_Version,4);
 	}
 	else
 	{
 		BL_Print_Message("CRC Verification Failed \r\n");
-		BL_Send_ACK_NACK(BL_NACK,0);
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
 }
 
@@ -233,20 +720,19 @@ static void BL_Get_Help(uint8_t *Hostbuffer)
 	BL_Print_Message("Read the commands supported by the bootloader \r\n");
 	
 	/* Get the CRC value and the length sent by the user */
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
 	/* CRC Verification */
 	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
 		BL_Print_Message("CRC Verification Passed \r\n");
-		BL_Send_ACK_NACK(BL_OK,12);
-		BL_Send_Data_To_Host(BL_Supported_Commands,12);
+		BL_Send_ACK_NACK(BL_OK,BL_Supported_Commands,sizeof(BL_Supported_Commands));
 	}
 	else
 	{
 		BL_Print_Message("CRC Verification Failed \r\n");
-		BL_Send_ACK_NACK(BL_NACK,0);
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
 }
 
@@ -258,7 +744,7 @@ static void BL_Get_Chip_ID(uint8_t *Hostbuffer)
 	BL_Print_Message("Read the MCU Chip identification number \r\n");
 	
 	/* Get the CRC value and the length sent by the user */
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
 	uint16_t MCU_ID = 0;
@@ -266,14 +752,13 @@ static void BL_Get_Chip_ID(uint8_t *Hostbuffer)
 	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
 		BL_Print_Message("CRC Verification Passed \r\n");
-		BL_Send_ACK_NACK(BL_OK,2);
 		MCU_ID = (uint16_t)(DBGMCU->IDCODE & 0xFFF); /*To get the id only which is first 11 bits */
-		BL_Send_Data_To_Host((uint8_t *)&MCU_ID,2);
+		BL_Send_ACK_NACK(BL_OK,(uint8_t *)&MCU_ID,2);
 	}
 	else
 	{
 		BL_Print_Message("CRC Verification Failed \r\n");
-		BL_Send_ACK_NACK(BL_NACK,0);
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
 }
 
@@ -291,305 +776,1956 @@ static uint8_t BL_GET_RDP_LEVEL(void)
 	}
 	else
 	{
-		RDP_Value = FLASH_RDP_LEVEL_1 ;
+		RDP_Value = FLASH_RDP_LEVEL_1 ;
+	}
+	return (RDP_Value) ;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Get_Read_Protection_Level
+********************************************************************************/
+static void BL_Get_Read_Protection_Level(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Read the flash read protection level \r\n");
+
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		uint8_t RDP_Level = BL_GET_RDP_LEVEL();
+		BL_Send_ACK_NACK(BL_OK,&RDP_Level,1);
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Host_Jump_Address_Verify
+********************************************************************************/
+static uint8_t BL_Host_Jump_Address_Verify(uint32_t Jump_Address)
+{
+	uint8_t Address_Verification = ADDRESS_IS_INVALID;
+	
+	if( ((Jump_Address >= STM32F103_SRAM_START) && (Jump_Address <= STM32F103_SRAM_END)) \
+		|| ((Jump_Address >= STM32F103_FLASH_START) && (Jump_Address <= STM32F103_FLASH_END)))
+	{
+		Address_Verification = ADDRESS_IS_VALID;
+	}
+	else
+	{
+		Address_Verification = ADDRESS_IS_INVALID;
+	}
+	return Address_Verification;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Jump_To_User_App
+********************************************************************************/
+static void BL_Jump_To_User_App(void)
+{
+	#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+	/* Last gate before an image runs, the jump command checked it already so the metadata answers */
+	if(BL_APP_IMAGE_VALID != BL_App_Image_Check())
+	{
+		return;
+	}
+	#endif
+	/* Value if the main stack pointer of our main application */
+	uint32_t MSP_Value = *((volatile uint32_t *)APP_BASE_ADDREESS);
+	
+	/* Reset handler definition function of our main application */
+	uint32_t MainAppAddr = *((volatile uint32_t *)(APP_BASE_ADDREESS+4));
+	pFunction APP_ResetHandler_Address = (pFunction)MainAppAddr;
+	
+	/* The reply of the jump command must leave before the uart is stopped */
+	BL_Host_Transport->Flush();
+	
+	/* Set the main stack pointer to its value */
+	__set_MSP(MSP_Value);
+	
+	/* Deintialization of module */
+	BL_Host_Transport->DeInit(); /* Stop the host link reception and its interrupts */
+	HAL_RCC_DeInit(); /* Reset the RCC clock configuration to the deafult reset state */
+	
+	/* Jump to application reset handler */
+	APP_ResetHandler_Address();
+}
+
+#ifdef BL_ENABLE_APP_IMAGE_CHECK
+/*******************************************************************************
+* Function Name:		BL_App_Image_Check
+********************************************************************************/
+static uint8_t BL_App_Image_Check(void)
+{
+	const uint32_t *Trailer = (const uint32_t *)BL_APP_TRAILER_ADDRESS;
+	uint8_t CRC_Mode = BL_CRC_Mode;
+	uint32_t Image_CRC = 0;
+	
+	if((BL_APP_TRAILER_MAGIC != Trailer[0]) || (0 == Trailer[1]) || (Trailer[1] > BL_APP_MAX_SIZE)
+		|| (Trailer[3] != (Trailer[0] ^ Trailer[1] ^ Trailer[2])))
+	{
+		return BL_APP_IMAGE_INVALID;
+	}
+	if(!BL_Meta.Loaded)
+	{
+		BL_Meta_Load();
+	}
+	/* Nothing was written to the application area since this image was validated */
+	if((BL_META_RECORD_VALIDATED == BL_Meta.Last.Type) && (Trailer[2] == BL_Meta.Last.Image_CRC))
+	{
+		return BL_APP_IMAGE_VALID;
+	}
+	/* The trailer CRC is always v2, whatever mode the host link uses */
+	BL_CRC_Mode = BL_APP_CRC_MODE;
+	Image_CRC = BL_CRC_Calculate_Region(APP_BASE_ADDREESS,Trailer[1]);
+	BL_CRC_Mode = CRC_Mode;
+	if(Image_CRC != Trailer[2])
+	{
+		return BL_APP_IMAGE_INVALID;
+	}
+	#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+	/* Only a signed image gets the validated record, the next boots skip both checks */
+	if(BL_SIGNATURE_VALID != BL_App_Signature_Check(Trailer[1]))
+	{
+		return BL_APP_IMAGE_INVALID;
+	}
+	#endif
+	BL_Meta_Append(BL_META_RECORD_VALIDATED,Image_CRC);
+	return BL_APP_IMAGE_VALID;
+}
+#endif
+
+#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+/*******************************************************************************
+* Function Name:		BL_App_Signature_Check
+********************************************************************************/
+static uint8_t BL_App_Signature_Check(uint32_t Image_Length)
+{
+	BL_SHA256_Context SHA256_Context;
+	uint8_t Digest[BL_SHA256_DIGEST_SIZE];
+	uint32_t Start_Cycles = DWT->CYCCNT;
+	uint8_t Signature_Status = BL_SIGNATURE_INVALID;
+	
+	/* Hashed straight from the flash */
+	BL_SHA256_Init(&SHA256_Context);
+	BL_SHA256_Update(&SHA256_Context,(const uint8_t *)APP_BASE_ADDREESS,Image_Length);
+	BL_SHA256_Final(&SHA256_Context,Digest);
+	Signature_Status = BL_RSA_Verify(&BL_App_Public_Key,(const uint8_t *)BL_APP_SIGNATURE_ADDRESS,Digest);
+	BL_Verify_Time_us = (DWT->CYCCNT - Start_Cycles) / (SystemCoreClock / 1000000);
+	BL_Print_Message("Signature Check %s in %lu us \r\n",(BL_SIGNATURE_VALID == Signature_Status) ? "Passed" : "Failed",
+		(unsigned long)BL_Verify_Time_us);
+	return Signature_Status;
+}
+#endif
+
+/*******************************************************************************
+* Function Name:		BL_App_Area_Changed
+********************************************************************************/
+static void BL_App_Area_Changed(uint32_t Address, uint32_t Length)
+{
+	if((Address >= BL_METADATA_PAGE_ADDRESS) || ((Address + Length) <= APP_BASE_ADDREESS))
+	{
+		return;
+	}
+	if(!BL_Meta.Loaded)
+	{
+		BL_Meta_Load();
+	}
+	BL_App_Written = 1;
+	/* One write record covers all the changes till the next validation */
+	if(BL_META_RECORD_WRITE != BL_Meta.Last.Type)
+	{
+		BL_Meta_Append(BL_META_RECORD_WRITE,BL_Meta.Last.Image_CRC);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Meta_Load
+********************************************************************************/
+static void BL_Meta_Load(void)
+{
+	const BL_Meta_Record *Record = (const BL_Meta_Record *)BL_METADATA_PAGE_ADDRESS;
+	
+	memset(&BL_Meta,0,sizeof(BL_Meta));
+	for(BL_Meta.Next_Record = 0 ; BL_Meta.Next_Record < BL_META_RECORDS_NUMBER ; BL_Meta.Next_Record++, Record++)
+	{
+		if(BL_META_RECORD_ERASED == Record->Type)
+		{
+			break;
+		}
+		if(Record->Check == (Record->Type ^ Record->Image_CRC ^ Record->Write_Count))
+		{
+			BL_Meta.Last = *Record;
+		}
+		else
+		{
+			/* Cut by a reset while it was programmed, keep the count and trust nothing else */
+			BL_Meta.Last.Type = 0;
+		}
+	}
+	BL_Meta.Loaded = 1;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Meta_Append
+********************************************************************************/
+static void BL_Meta_Append(uint32_t Type, uint32_t Image_CRC)
+{
+	BL_Meta_Record Record;
+	uint8_t Write_Status = FLASH_WRITE_FAILED;
+	
+	if(!BL_Meta.Loaded)
+	{
+		BL_Meta_Load();
+	}
+	if(BL_Meta.Next_Record >= BL_META_RECORDS_NUMBER)
+	{
+		BL_Perform_Page_Erase(BL_METADATA_PAGE_ADDRESS);
+		BL_Meta.Next_Record = 0;
+		BL_Meta.Loaded = 1;
+	}
+	Record.Type = Type;
+	Record.Image_CRC = Image_CRC;
+	Record.Write_Count = BL_Meta.Last.Write_Count + ((BL_META_RECORD_WRITE == Type) ? 1 : 0);
+	Record.Check = Record.Type ^ Record.Image_CRC ^ Record.Write_Count;
+	BL_Meta.Appending = 1;
+	Write_Status = BL_Write_Payload_In_Flash((uint8_t *)&Record,
+		BL_METADATA_PAGE_ADDRESS + (BL_Meta.Next_Record * BL_META_RECORD_SIZE),BL_META_RECORD_SIZE);
+	BL_Meta.Appending = 0;
+	if(FLASH_WRITE_PASSED == Write_Status)
+	{
+		BL_Meta.Last = Record;
+	}
+	else
+	{
+		BL_Meta.Last.Type = 0;
+	}
+	BL_Meta.Next_Record++;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Image_Hash_Update
+********************************************************************************/
+static void BL_Image_Hash_Update(uint32_t Address, uint32_t Length)
+{
+	uint32_t End_Address = Address + Length;
+	
+	if((Address >= BL_METADATA_PAGE_ADDRESS) || (End_Address <= APP_BASE_ADDREESS))
+	{
+		return;
+	}
+	if(End_Address > BL_METADATA_PAGE_ADDRESS)
+	{
+		End_Address = BL_METADATA_PAGE_ADDRESS;
+	}
+	if(!BL_Image_Hash.Active)
+	{
+		BL_Image_Hash.Active = 1;
+		BL_Image_Hash.Out_Of_Order = 0;
+		BL_Image_Hash.Next_Address = APP_BASE_ADDREESS;
+		BL_Image_Hash.Pending = 0;
+		BL_Image_Hash.CRC_Value = BL_CRC_RESET_VALUE;
+	}
+	/* A write behind the bytes already fed would feed the image again from the base on
+	 * every out of order packet, stop here and read the image once at its end */
+	if(Address < BL_Image_Hash.Next_Address)
+	{
+		BL_Image_Hash.Out_Of_Order = 1;
+	}
+	if(!BL_Image_Hash.Out_Of_Order)
+	{
+		BL_Image_Hash_Feed(End_Address);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Image_Hash_Feed
+********************************************************************************/
+static void BL_Image_Hash_Feed(uint32_t End_Address)
+{
+	uint32_t Address = BL_Image_Hash.Next_Address;
+	
+	if(Address >= End_Address)
+	{
+		return;
+	}
+	BL_CRC_Seed(BL_Image_Hash.CRC_Value);
+	while(Address < End_Address)
+	{
+		/* The words are aligned as the image starts on APP_BASE_ADDREESS */
+		if((0 == (Address % 4)) && ((End_Address - Address) >= 4))
+		{
+			BL_CRC_WRITE(*((volatile uint32_t *)Address));
+			Address += 4;
+		}
+		else
+		{
+			BL_Image_Hash.Pending |= (uint32_t)(*((volatile uint8_t *)Address)) << (8 * (Address % 4));
+			Address++;
+			if(0 == (Address % 4))
+			{
+				BL_CRC_WRITE(BL_Image_Hash.Pending);
+				BL_Image_Hash.Pending = 0;
+			}
+		}
+	}
+	BL_Image_Hash.CRC_Value = BL_CRC_READ();
+	BL_Image_Hash.Next_Address = Address;
+	BL_CRC_RESET();
+}
+
+/*******************************************************************************
+* Function Name:		BL_Image_Hash_Erased
+********************************************************************************/
+static void BL_Image_Hash_Erased(uint32_t Address)
+{
+	/* The whole area erased, the next image starts a new stream */
+	if(Address <= APP_BASE_ADDREESS)
+	{
+		BL_Image_Hash.Active = 0;
+	}
+	/* The fed bytes may be gone, erasing the pages ahead (page diff update) keeps it going */
+	else if(Address < BL_Image_Hash.Next_Address)
+	{
+		BL_Image_Hash.Out_Of_Order = 1;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Jump_To_Address
+********************************************************************************/
+static void BL_Jump_To_Address(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Jump bootloader to specified address \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* Extract the jump address and verify it */
+	uint32_t Host_Jump_Address = *((uint32_t *)(Hostbuffer+2));
+	
+		/* CRC Verification */
+		if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+		{
+			
+			BL_Print_Message("CRC Verification Passed \r\n");
+			
+			uint8_t Address_Verification = BL_Host_Jump_Address_Verify(Host_Jump_Address);
+			#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+			/* Any other address could run unsigned code written to the application area */
+			if(Host_Jump_Address != APP_BASE_ADDREESS)
+			{
+				Address_Verification = ADDRESS_IS_INVALID;
+			}
+			#endif
+			if(ADDRESS_IS_VALID == Address_Verification)
+			{
+				BL_Print_Message("Address Verification Passed \r\n");
+				#ifdef BL_ENABLE_APP_IMAGE_CHECK
+				if((Host_Jump_Address == APP_BASE_ADDREESS) && (BL_APP_IMAGE_VALID != BL_App_Image_Check()))
+				{
+					BL_Print_Message("Application Image Check Failed \r\n");
+					Address_Verification = ADDRESS_APP_IMAGE_INVALID;
+					BL_Send_ACK_NACK(BL_OK,&Address_Verification,1);
+					return;
+				}
+				#endif
+				BL_Send_ACK_NACK(BL_OK,&Address_Verification,1);
+				/* A jump never comes back, so a batch replies here */
+				BL_Batch_Send_Reply();
+				/* If we received this specific address we will assume that the user want
+				 * to end the bootloader and go to the app */
+				if( Host_Jump_Address == APP_BASE_ADDREESS )
+				{
+					BL_Jump_To_User_App();
+					/* Back only if the image failed its last check, it must not run through the jump below */
+					BL_Print_Message("Application Image Check Failed \r\n");
+					return;
+				}
+				if((Host_Jump_Address & 0x01) == 0)
+				{
+					/* To ensure that the function address LSB = one which stands for Thumb state  */
+					Host_Jump_Address++;
+				} 
+				pFunction Jump_Address = (pFunction)Host_Jump_Address ;
+				BL_Host_Transport->Flush();
+				Jump_Address();
+			}
+			else
+			{
+				BL_Print_Message("Address Verification Failed \r\n");
+				BL_Send_ACK_NACK(BL_OK,&Address_Verification,1);
+			}
+		}
+		else
+		{
+			BL_Print_Message("CRC Verification Failed \r\n");
+			BL_Send_ACK_NACK(BL_NACK,NULL,0);
+		}	
+}
+
+/*******************************************************************************
+* Function Name:		BL_Perform_Flash_Erase
+********************************************************************************/
+static uint8_t BL_Perform_Flash_Erase(uint8_t Sector_Number, uint8_t Number_Of_Sectors)
+{
+	uint8_t Erase_Status = ERASE_UNSUCCESSFUL;
+	if(( (Number_Of_Sectors+Sector_Number) <= MAX_SECTOR_NUMBER ) || (ERASE_ALL_COMMAND == Sector_Number))
+	{
+		FLASH_EraseInitTypeDef pEraseInit;
+		uint32_t PageError;
+		if((Number_Of_Sectors+Sector_Number) <= MAX_SECTOR_NUMBER)
+		{
+			pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+		}
+		else
+		{
+			pEraseInit.TypeErase = FLASH_TYPEERASE_MASSERASE;
+		}
+		pEraseInit.Banks = FLASH_BANK_1;
+		pEraseInit.PageAddress = STM32F103_FLASH_START + (PAGE_SIZE*PAGES_PER_SECTOR*Sector_Number);
+		pEraseInit.NbPages = Number_Of_Sectors * PAGES_PER_SECTOR;
+		
+		if(FLASH_TYPEERASE_MASSERASE == pEraseInit.TypeErase)
+		{
+			BL_App_Area_Changed(STM32F103_FLASH_START,STM32F103_FLASH_END - STM32F103_FLASH_START);
+			BL_Image_Hash_Erased(STM32F103_FLASH_START);
+		}
+		else
+		{
+			BL_App_Area_Changed(pEraseInit.PageAddress,pEraseInit.NbPages * PAGE_SIZE);
+			BL_Image_Hash_Erased(pEraseInit.PageAddress);
+		}
+		/* Start Erasing */
+		HAL_FLASH_Unlock();
+		HAL_FLASHEx_Erase(&pEraseInit,&PageError);
+		HAL_FLASH_Lock();
+		/* The metadata page may be gone, read it again when needed */
+		BL_Meta.Loaded = 0;
+		
+		if(PAGE_ERASE_SUCCESS == PageError)
+		{
+			Erase_Status = ERASE_SUCCESSFUL;
+		}
+		else
+		{
+			Erase_Status = ERASE_UNSUCCESSFUL;
+		}
+	}
+	else
+	{
+		Erase_Status = SECTOR_NUMBER_INVALID;
+	}
+	return Erase_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Perform_Page_Erase
+********************************************************************************/
+static uint8_t BL_Perform_Page_Erase(uint32_t Page_Address)
+{
+	FLASH_EraseInitTypeDef pEraseInit;
+	uint32_t PageError = 0;
+	
+	pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+	pEraseInit.Banks = FLASH_BANK_1;
+	pEraseInit.PageAddress = Page_Address;
+	pEraseInit.NbPages = 1;
+	
+	BL_App_Area_Changed(Page_Address,PAGE_SIZE);
+	BL_Image_Hash_Erased(Page_Address);
+	HAL_FLASH_Unlock();
+	HAL_FLASHEx_Erase(&pEraseInit,&PageError);
+	HAL_FLASH_Lock();
+	
+	return (PAGE_ERASE_SUCCESS == PageError) ? ERASE_SUCCESSFUL : ERASE_UNSUCCESSFUL;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Erase_Flash
+********************************************************************************/
+static void BL_Erase_Flash(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Mass erase or sector erase of user flash \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	uint8_t Erase_Status = 0;
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		
+		/* Erase the required secotrs */
+		Erase_Status = BL_Perform_Flash_Erase(Hostbuffer[2],Hostbuffer[3]);
+		if(ERASE_SUCCESSFUL == Erase_Status)
+		{
+			BL_Print_Message("Erase Is Done \r\n");
+		}
+		else
+		{
+			BL_Print_Message("Erase Failed \r\n");
+		}
+		BL_Send_ACK_NACK(BL_OK,&Erase_Status,1);
+		
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Write_Payload_In_Flash
+********************************************************************************/
+static uint8_t BL_Write_Payload_In_Flash(uint8_t *Host_Payload, uint32_t Start_Address, uint16_t Payload_Len)
+{
+	uint8_t Write_Status = FLASH_WRITE_FAILED;
+	
+	BL_App_Area_Changed(Start_Address,Payload_Len);
+	Write_Status = BL_Flash_Program(Host_Payload,Start_Address,Payload_Len);
+	/* What the flash holds now, a half word that didn't program shows in the image CRC */
+	BL_Image_Hash_Update(Start_Address,Payload_Len);
+	
+	return Write_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Flash_Program
+********************************************************************************/
+static uint8_t BL_Flash_Program(uint8_t *Host_Payload, uint32_t Start_Address, uint16_t Payload_Len)
+{
+	HAL_StatusTypeDef HAL_Status = HAL_ERROR;
+	uint16_t Payload_Counter = 0;
+	uint8_t Write_Status = FLASH_WRITE_FAILED;
+	
+	#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+	/* The host programs the application area only, code added to the BL or a forged validated
+	 * record in the metadata page would get around the signature */
+	if((!BL_Meta.Appending) && ((Start_Address < APP_BASE_ADDREESS) || ((Start_Address + Payload_Len) > BL_METADATA_PAGE_ADDRESS)))
+	{
+		return FLASH_WRITE_FAILED;
+	}
+	#endif
+	/* Unlock the flash memory */
+	HAL_Status = HAL_FLASH_Unlock();
+	
+	if(HAL_OK != HAL_Status)
+	{
+		Write_Status = FLASH_WRITE_FAILED;
+	}
+	else
+	{
+		/* If unlock passed then write the flash */
+		for(Payload_Counter = 0 ; Payload_Counter < Payload_Len ; Payload_Counter+= 2)
+		{
+			uint16_t Half_Word = *((uint16_t*)(&Host_Payload[Payload_Counter]));
+			/* Programming 0xFFFF over an erased half word changes nothing and costs a program cycle */
+			if((FLASH_ERASED_HALF_WORD == Half_Word)
+				&& (FLASH_ERASED_HALF_WORD == *((volatile uint16_t *)(Start_Address+Payload_Counter))))
+			{
+				continue;
+			}
+			HAL_Status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,Start_Address+Payload_Counter,Half_Word);
+			if(HAL_OK != HAL_Status)
+			{
+				break;
+			}
+		}
+		//HAL_Status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,0x08008000,0xBBAA);
+		
+	}
+	
+	if(HAL_OK != HAL_Status)
+	{
+		Write_Status = FLASH_WRITE_FAILED;
+	}
+	else
+	{
+		Write_Status = FLASH_WRITE_PASSED;
+	}
+	
+	HAL_Status = HAL_FLASH_Lock();
+	
+	return Write_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Fill_Flash
+********************************************************************************/
+static uint8_t BL_Fill_Flash(uint32_t Start_Address, uint32_t Length, uint32_t Pattern, uint8_t Pattern_Size)
+{
+	uint8_t Pattern_Block[BL_FILL_BLOCK_SIZE];
+	uint8_t Write_Status = FLASH_WRITE_PASSED;
+	uint32_t Offset = 0;
+	uint16_t Block_Len = 0;
+	
+	/* The block is a whole number of patterns so every block starts with the pattern */
+	for(Offset = 0 ; Offset < BL_FILL_BLOCK_SIZE ; Offset++)
+	{
+		Pattern_Block[Offset] = (uint8_t)(Pattern >> (8 * (Offset % Pattern_Size)));
+	}
+	/* The metadata and the image CRC follow the whole range, the blocks only program */
+	BL_App_Area_Changed(Start_Address,Length);
+	for(Offset = 0 ; (Offset < Length) && (FLASH_WRITE_PASSED == Write_Status) ; Offset += Block_Len)
+	{
+		Block_Len = ((Length - Offset) > BL_FILL_BLOCK_SIZE) ? BL_FILL_BLOCK_SIZE : (uint16_t)(Length - Offset);
+		Write_Status = BL_Flash_Program(Pattern_Block,Start_Address+Offset,Block_Len);
+	}
+	BL_Image_Hash_Update(Start_Address,Length);
+	
+	return Write_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Fill
+********************************************************************************/
+static void BL_Memory_Fill(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Fill a flash range with a pattern \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* The arguments are read at fixed offsets, a frame of another size is not a fill */
+	if(BL_FILL_FRAME_LEN != Host_CMD_Packet_Len)
+	{
+		BL_Print_Message("Frame Length Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+	/* CRC Verification */
+	else if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		
+		uint32_t Start_Address = *((uint32_t *)(Hostbuffer+2));
+		uint32_t Length = *((uint32_t *)(Hostbuffer+6));
+		uint8_t Pattern_Size = Hostbuffer[10];
+		uint32_t Pattern = *((uint32_t *)(Hostbuffer+11));
+		uint8_t Write_Status = FLASH_WRITE_FAILED;
+		
+		/* Half word aligned range inside the flash after the BL */
+		if(((BL_FILL_PATTERN_HALF_WORD == Pattern_Size) || (BL_FILL_PATTERN_WORD == Pattern_Size))
+			&& (0 != Length) && (0 == ((Start_Address | Length) & 0x01))
+			&& (Start_Address >= BL_FILL_START_ADDRESS) && (Start_Address < BL_FILL_END_ADDRESS)
+			&& (Length <= (BL_FILL_END_ADDRESS - Start_Address)))
+		{
+			Write_Status = BL_Fill_Flash(Start_Address,Length,Pattern,Pattern_Size);
+		}
+		else
+		{
+			BL_Print_Message("Address, Length or Pattern Verification Failed \r\n");
+		}
+		if(FLASH_WRITE_PASSED == Write_Status)
+		{
+			BL_Print_Message("Fill Successed \r\n");
+		}
+		BL_Send_ACK_NACK(BL_OK,&Write_Status,1);
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Get_Write_Payload
+********************************************************************************/
+static uint8_t *BL_Get_Write_Payload(uint8_t *Hostbuffer, uint16_t Length_Offset, uint16_t *Payload_Len)
+{
+	uint16_t Payload_Offset = Length_Offset + 1;
+	
+	*Payload_Len = Hostbuffer[Length_Offset];
+	if(BL_FRAME_V2_MARKER == Hostbuffer[0])
+	{
+		*Payload_Len |= (uint16_t)(Hostbuffer[Length_Offset+1] << 8);
+		Payload_Offset++;
+	}
+	if((*Payload_Len > BL_WRITE_BUFFER_SIZE)
+		|| ((Payload_Offset + *Payload_Len + CRC_BYTE_SIZE) > BL_Host_Packet_Len))
+	{
+		return NULL;
+	}
+	return (Hostbuffer + Payload_Offset);
+}
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Service
+********************************************************************************/
+static void BL_Write_Pipeline_Service(void)
+{
+	BL_Write_Buffer *Buffer = &BL_Write_Buffers[BL_Write_Program_Index];
+	uint16_t Chunk_Len = 0;
+	
+	if(0 == BL_Write_Pending)
+	{
+		return;
+	}
+	/* The metadata and the image CRC follow the whole buffer, the chunks only program */
+	if(0 == Buffer->Programmed_Len)
+	{
+		BL_App_Area_Changed(Buffer->Start_Address,Buffer->Payload_Len);
+	}
+	/* Program a small chunk only so the caller can go back to the uart quickly */
+	Chunk_Len = Buffer->Payload_Len - Buffer->Programmed_Len;
+	if(Chunk_Len > BL_WRITE_CHUNK_SIZE)
+	{
+		Chunk_Len = BL_WRITE_CHUNK_SIZE;
+	}
+	if(FLASH_WRITE_PASSED == BL_Flash_Program(Buffer->Payload+Buffer->Programmed_Len,
+		Buffer->Start_Address+Buffer->Programmed_Len,Chunk_Len))
+	{
+		Buffer->Programmed_Len += Chunk_Len;
+	}
+	else
+	{
+		/* Drop the rest of this buffer, the host will get the failure in the next reply */
+		BL_Write_Status = FLASH_WRITE_FAILED;
+		Buffer->Programmed_Len = Buffer->Payload_Len;
+	}
+	
+	if(Buffer->Programmed_Len >= Buffer->Payload_Len)
+	{
+		/* What the flash holds now, a half word that didn't program shows in the image CRC */
+		BL_Image_Hash_Update(Buffer->Start_Address,Buffer->Payload_Len);
+		BL_Write_Pending--;
+		BL_Write_Program_Index = (BL_Write_Program_Index + 1) % BL_WRITE_BUFFERS_NUMBER;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Flush
+********************************************************************************/
+static uint8_t BL_Write_Pipeline_Flush(void)
+{
+	uint8_t Write_Status = FLASH_WRITE_PASSED;
+	
+	while(BL_Write_Pending)
+	{
+		BL_Write_Pipeline_Service();
+	}
+	/* Report the failure only once */
+	Write_Status = BL_Write_Status;
+	BL_Write_Status = FLASH_WRITE_PASSED;
+	
+	return Write_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Get_Buffer
+********************************************************************************/
+static uint8_t *BL_Write_Pipeline_Get_Buffer(void)
+{
+	/* Both buffers are busy so finish the oldest one first */
+	while(BL_WRITE_BUFFERS_NUMBER == BL_Write_Pending)
+	{
+		BL_Write_Pipeline_Service();
+	}
+	
+	return BL_Write_Buffers[BL_Write_Fill_Index].Payload;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Commit
+********************************************************************************/
+static void BL_Write_Pipeline_Commit(uint32_t Start_Address, uint16_t Payload_Len)
+{
+	BL_Write_Buffer *Buffer = &BL_Write_Buffers[BL_Write_Fill_Index];
+	
+	Buffer->Start_Address = Start_Address;
+	Buffer->Payload_Len = Payload_Len;
+	Buffer->Programmed_Len = 0;
+	BL_Write_Fill_Index = (BL_Write_Fill_Index + 1) % BL_WRITE_BUFFERS_NUMBER;
+	BL_Write_Pending++;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Queue
+********************************************************************************/
+static uint8_t BL_Write_Pipeline_Queue(uint8_t *Host_Payload, uint32_t Start_Address, uint16_t Payload_Len)
+{
+	uint8_t Write_Status = FLASH_WRITE_PASSED;
+	
+	memcpy(BL_Write_Pipeline_Get_Buffer(),Host_Payload,Payload_Len);
+	BL_Write_Pipeline_Commit(Start_Address,Payload_Len);
+	
+	/* Report the failure only once */
+	Write_Status = BL_Write_Status;
+	BL_Write_Status = FLASH_WRITE_PASSED;
+	
+	return Write_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Write
+********************************************************************************/
+static void BL_Memory_Write(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Write data into different memories of the MCU \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		
+		/* Extract the start address and the payload length */
+		uint32_t Start_Address = *((uint32_t *)(Hostbuffer+2)) ;
+		uint16_t Payload_Len = 0;
+		uint8_t *Payload = BL_Get_Write_Payload(Hostbuffer,6,&Payload_Len);
+		uint8_t Address_Verification = BL_Host_Jump_Address_Verify(Start_Address);
+		if((ADDRESS_IS_VALID == Address_Verification) && (NULL != Payload))
+		{
+			BL_Print_Message("Address Verification Passed \r\n");
+			uint8_t Write_Status = FLASH_WRITE_PASSED;
+			uint8_t Reply[BL_WRITE_END_REPLY_LEN] = {0};
+			uint8_t Reply_Len = 1;
+			if(0 == Payload_Len)
+			{
+				/* Empty packet closes the write session with the status of all the packets */
+				Write_Status = BL_Write_Pipeline_Flush();
+				#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+				/* A session that changed the application area gets its image checked now */
+				if((FLASH_WRITE_PASSED == Write_Status) && (BL_App_Written))
+				{
+					BL_Verify_Time_us = 0;
+					Reply[1] = BL_App_Image_Check();
+					memcpy(&Reply[2],&BL_Verify_Time_us,sizeof(BL_Verify_Time_us));
+					Reply_Len = BL_WRITE_END_REPLY_LEN;
+				}
+				BL_App_Written = 0;
+				#endif
+			}
+			else
+			{
+				/* The packet is programmed while the host sends the next one, the reply
+				 * carries the status of the previously programmed packets */
+				Write_Status = BL_Write_Pipeline_Queue(Payload,Start_Address,Payload_Len);
+			}
+			if(FLASH_WRITE_PASSED == Write_Status)
+			{
+				BL_Print_Message("Wite Successed \r\n");
+			}
+			else
+			{
+				BL_Print_Message("Wite Failed \r\n");
+			}
+			Reply[0] = Write_Status;
+			BL_Send_ACK_NACK(BL_OK,Reply,Reply_Len);
+		}
+		else
+		{
+			BL_Print_Message("Address or Length Verification Failed \r\n");
+			Address_Verification = FLASH_WRITE_FAILED;
+			BL_Send_ACK_NACK(BL_OK,&Address_Verification,1);
+		}
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Window_Send_Reply
+********************************************************************************/
+static void BL_Window_Send_Reply(BL_Status BL_Message, uint16_t Sequence_Number, uint8_t Write_Status)
+{
+	uint8_t Reply[BL_WINDOW_REPLY_LEN] = {0,0,Write_Status};
+	Reply[0] = (uint8_t)(Sequence_Number & 0xFF);
+	Reply[1] = (uint8_t)(Sequence_Number >> 8);
+	BL_Send_ACK_NACK(BL_Message,Reply,BL_WINDOW_REPLY_LEN);
+}
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Write_Window_Start
+********************************************************************************/
+static void BL_Memory_Write_Window_Start(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Open a sliding window write session \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		/* Older hosts don't send their frame payload, they use one page per frame */
+		uint16_t Payload_Len = BL_WRITE_BUFFER_SIZE;
+		if(Host_CMD_Packet_Len >= BL_WINDOW_START_LEN)
+		{
+			Payload_Len = (uint16_t)(Hostbuffer[3] | (Hostbuffer[4] << 8));
+			if((0 == Payload_Len) || (Payload_Len > BL_WRITE_BUFFER_SIZE))
+			{
+				Payload_Len = BL_WRITE_BUFFER_SIZE;
+			}
+		}
+		
+		/* Take the host window unless our ring can't hold it */
+		uint8_t Window_Size = Hostbuffer[2];
+		if(Window_Size > BL_WRITE_WINDOW_MAX(Payload_Len))
+		{
+			Window_Size = BL_WRITE_WINDOW_MAX(Payload_Len);
+		}
+		else if(0 == Window_Size)
+		{
+			Window_Size = 1;
+		}
+		BL_Window_Size = Window_Size;
+		BL_Window_Expected_Seq = 0;
+		BL_Window_Close_Status = FLASH_WRITE_PASSED;
+		BL_Window_Unacked = 0;
+		BL_Window_Nack_Sent = 0;
+		BL_Send_ACK_NACK(BL_OK,&Window_Size,1);
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Window_Report_Missing
+********************************************************************************/
+static void BL_Window_Report_Missing(void)
+{
+	if(0 == BL_Window_Nack_Sent)
+	{
+		BL_Print_Message("Frame %d Missing \r\n",BL_Window_Expected_Seq);
+		BL_Window_Send_Reply(BL_NACK,BL_Window_Expected_Seq,FLASH_WRITE_PASSED);
+		BL_Window_Nack_Sent = 1;
+		BL_Window_Unacked = 0;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Write_Sequenced
+********************************************************************************/
+static void BL_Memory_Write_Sequenced(uint8_t *Hostbuffer)
+{
+	/* No debug messages here as the frames come back to back */
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	uint16_t Sequence_Number = (uint16_t)(Hostbuffer[2] | (Hostbuffer[3] << 8));
+	uint8_t Write_Status = FLASH_WRITE_PASSED;
+	
+	/* A frame resent after the session closed (the last ACK was lost) gets the
+	 * next expected frame and the status the session closed with */
+	if(BL_WINDOW_CLOSED == BL_Window_Size)
+	{
+		BL_Window_Send_Reply(BL_NACK,BL_Window_Expected_Seq,BL_Window_Close_Status);
+		return;
+	}
+	
+	/* A corrupted or out of order frame is dropped with all the frames after it,
+	 * the host gets only one NACK naming the first missing frame */
+	if((CRC_OK != BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+		|| (Sequence_Number != BL_Window_Expected_Seq))
+	{
+		BL_Window_Report_Missing();
+		return;
+	}
+	BL_Window_Nack_Sent = 0;
+	
+	/* Extract the start address and the payload length */
+	uint32_t Start_Address = *((uint32_t *)(Hostbuffer+4)) ;
+	uint16_t Payload_Len = 0;
+	uint8_t *Payload = BL_Get_Write_Payload(Hostbuffer,8,&Payload_Len);
+	if((ADDRESS_IS_VALID != BL_Host_Jump_Address_Verify(Start_Address)) || (NULL == Payload))
+	{
+		Write_Status = FLASH_WRITE_FAILED;
+	}
+	else if(0 == Payload_Len)
+	{
+		/* Empty frame closes the session with the status of all the frames */
+		Write_Status = BL_Write_Pipeline_Flush();
+		BL_Window_Size = BL_WINDOW_CLOSED;
+		BL_Window_Close_Status = Write_Status;
+	}
+	else
+	{
+		Write_Status = BL_Write_Pipeline_Queue(Payload,Start_Address,Payload_Len);
+	}
+	BL_Window_Expected_Seq++;
+	BL_Window_Unacked++;
+	
+	/* Cumulative ACK every half window, when the host stopped sending, on
+	 * failures and at the end of the session */
+	if((FLASH_WRITE_PASSED != Write_Status) || (BL_WINDOW_CLOSED == BL_Window_Size)
+		|| (BL_Window_Unacked >= ((BL_Window_Size + 1) / 2)) || (0 == BL_Host_Rx_Available()))
+	{
+		BL_Window_Send_Reply(BL_OK,Sequence_Number,Write_Status);
+		BL_Window_Unacked = 0;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Start
+********************************************************************************/
+static void BL_LZ_Start(uint32_t Start_Address)
+{
+	BL_LZ.Window_Index = 0;
+	BL_LZ.State = BL_LZ_FLAGS;
+	BL_LZ.Flags = 0;
+	BL_LZ.Flags_Left = 0;
+	BL_LZ.Active = 1;
+	BL_LZ.Status = FLASH_WRITE_PASSED;
+	BL_LZ.Start_Address = Start_Address;
+	BL_LZ.Output_Address = Start_Address;
+	BL_LZ.Output_Total = 0;
+	BL_LZ.Output_Len = 0;
+}
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Feed
+********************************************************************************/
+static void BL_LZ_Feed(uint8_t Data)
+{
+	uint16_t Distance = 0;
+	uint16_t Length = 0;
+	
+	/* The rest of a broken stream is dropped, the host gets the failure */
+	if(FLASH_WRITE_PASSED != BL_LZ.Status)
+	{
+		return;
+	}
+	
+	switch(BL_LZ.State)
+	{
+		case BL_LZ_FLAGS:
+			BL_LZ.Flags = Data;
+			BL_LZ.Flags_Left = BL_LZ_TOKENS_PER_FLAG;
+			BL_LZ.State = BL_LZ_TOKEN;
+			return;
+		
+		case BL_LZ_TOKEN:
+			if(BL_LZ.Flags & BL_LZ_LITERAL_FLAG)
+			{
+				BL_LZ_Put_Byte(Data);
+			}
+			else
+			{
+				BL_LZ.Match_Distance = Data;
+				BL_LZ.State = BL_LZ_MATCH_LENGTH;
+				return;
+			}
+			break;
+		
+		case BL_LZ_MATCH_LENGTH:
+			Distance = (uint16_t)BL_LZ.Match_Distance + 1;
+			Length = (uint16_t)Data + BL_LZ_MIN_MATCH;
+			if(Distance > BL_LZ.Output_Total)
+			{
+				/* Match before the image start */
+				BL_LZ.Status = FLASH_WRITE_FAILED;
+				return;
+			}
+			/* Byte by byte as the match may overlap the bytes it produces */
+			while(Length--)
+			{
+				BL_LZ_Put_Byte(BL_LZ.Window[(BL_LZ.Window_Index - Distance) & (BL_LZ_WINDOW_SIZE - 1)]);
+			}
+			break;
+		
+		default:
+			break;
+	}
+	
+	/* Next token of the flag byte */
+	BL_LZ.Flags >>= 1;
+	BL_LZ.Flags_Left--;
+	BL_LZ.State = (0 == BL_LZ.Flags_Left) ? BL_LZ_FLAGS : BL_LZ_TOKEN;
+}
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Put_Byte
+********************************************************************************/
+static void BL_LZ_Put_Byte(uint8_t Data)
+{
+	if(0 == BL_LZ.Output_Len)
+	{
+		BL_LZ.Output = BL_Write_Pipeline_Get_Buffer();
+	}
+	BL_LZ.Output[BL_LZ.Output_Len++] = Data;
+	BL_LZ.Window[BL_LZ.Window_Index] = Data;
+	BL_LZ.Window_Index = (BL_LZ.Window_Index + 1) & (BL_LZ_WINDOW_SIZE - 1);
+	BL_LZ.Output_Total++;
+	
+	if(BL_WRITE_BUFFER_SIZE == BL_LZ.Output_Len)
+	{
+		BL_LZ_Commit_Output();
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Commit_Output
+********************************************************************************/
+static void BL_LZ_Commit_Output(void)
+{
+	/* The flash is programmed by half words, pad the last byte of the image */
+	if(BL_LZ.Output_Len & 0x01)
+	{
+		BL_LZ.Output[BL_LZ.Output_Len++] = 0xFF;
+	}
+	if(ADDRESS_IS_VALID == BL_Host_Jump_Address_Verify(BL_LZ.Output_Address + BL_LZ.Output_Len - 1))
+	{
+		BL_Write_Pipeline_Commit(BL_LZ.Output_Address,BL_LZ.Output_Len);
+	}
+	else
+	{
+		BL_LZ.Status = FLASH_WRITE_FAILED;
+	}
+	BL_LZ.Output_Address += BL_LZ.Output_Len;
+	BL_LZ.Output_Len = 0;
+}
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Finish
+********************************************************************************/
+static uint8_t BL_LZ_Finish(void)
+{
+	uint8_t Write_Status = FLASH_WRITE_PASSED;
+	
+	/* Stream cut between the two bytes of a match */
+	if(BL_LZ_MATCH_LENGTH == BL_LZ.State)
+	{
+		BL_LZ.Status = FLASH_WRITE_FAILED;
+	}
+	if((FLASH_WRITE_PASSED == BL_LZ.Status) && (0 != BL_LZ.Output_Len))
+	{
+		BL_LZ_Commit_Output();
+	}
+	Write_Status = BL_Write_Pipeline_Flush();
+	if(FLASH_WRITE_PASSED != BL_LZ.Status)
+	{
+		Write_Status = FLASH_WRITE_FAILED;
+	}
+	BL_LZ.Active = 0;
+	
+	return Write_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Write_Compressed
+********************************************************************************/
+static void BL_Memory_Write_Compressed(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Write a compressed image into the flash \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		
+		/* Same layout as the memory write, the address is the image start in all the frames */
+		uint32_t Start_Address = *((uint32_t *)(Hostbuffer+2)) ;
+		uint16_t Payload_Len = 0;
+		uint8_t *Payload = BL_Get_Write_Payload(Hostbuffer,6,&Payload_Len);
+		uint8_t Write_Status = FLASH_WRITE_FAILED;
+		uint8_t Reply[BL_LZ_REPLY_LEN] = {0};
+		if((ADDRESS_IS_VALID == BL_Host_Jump_Address_Verify(Start_Address)) && (NULL != Payload))
+		{
+			if((0 == BL_LZ.Active) || (Start_Address != BL_LZ.Start_Address))
+			{
+				BL_LZ_Start(Start_Address);
+			}
+			if(0 == Payload_Len)
+			{
+				/* Empty packet closes the stream with the status of the whole image */
+				Write_Status = BL_LZ_Finish();
+			}
+			else
+			{
+				/* The pages are programmed while the rest of the frame is decompressed */
+				for(uint16_t Counter = 0 ; Counter < Payload_Len ; Counter++)
+				{
+					BL_LZ_Feed(Payload[Counter]);
+				}
+				/* Report the failure only once */
+				Write_Status = BL_Write_Status;
+				BL_Write_Status = FLASH_WRITE_PASSED;
+				if(FLASH_WRITE_PASSED != BL_LZ.Status)
+				{
+					Write_Status = FLASH_WRITE_FAILED;
+				}
+			}
+		}
+		else
+		{
+			BL_Print_Message("Address or Length Verification Failed \r\n");
+		}
+		Reply[0] = Write_Status;
+		memcpy(Reply+1,&BL_LZ.Output_Total,sizeof(BL_LZ.Output_Total));
+		BL_Send_ACK_NACK(BL_OK,Reply,BL_LZ_REPLY_LEN);
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Start
+********************************************************************************/
+static void BL_Delta_Start(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Start a delta update of the application \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		
+		/* Old image length and CRC then the new image length and CRC */
+		uint32_t Old_Length = *((uint32_t *)(Hostbuffer+2));
+		uint32_t Old_CRC = *((uint32_t *)(Hostbuffer+6));
+		uint32_t New_Length = *((uint32_t *)(Hostbuffer+10));
+		uint32_t New_CRC = *((uint32_t *)(Hostbuffer+14));
+		uint8_t Source_Status = BL_DELTA_SOURCE_MISMATCH;
+		
+		/* The patch is only valid against the image it was made from */
+		if((Old_Length <= BL_APP_AREA_SIZE) && (0 != New_Length) && (New_Length <= BL_APP_AREA_SIZE)
+			&& (Old_CRC == BL_CRC_Calculate_Region(APP_BASE_ADDREESS,Old_Length)))
+		{
+			BL_Print_Message("Installed Image Matches the Patch \r\n");
+			BL_Write_Pipeline_Flush();
+			BL_Delta.State = BL_DELTA_OP;
+			BL_Delta.Active = 1;
+			BL_Delta.Status = FLASH_WRITE_PASSED;
+			BL_Delta.New_Length = New_Length;
+			BL_Delta.New_CRC = New_CRC;
+			BL_Delta.Output_Total = 0;
+			BL_Delta.Page_Len = 0;
+			Source_Status = BL_DELTA_SOURCE_VALID;
+		}
+		else
+		{
+			BL_Print_Message("Installed Image Doesn't Match the Patch \r\n");
+			BL_Delta.Active = 0;
+		}
+		BL_Send_ACK_NACK(BL_OK,&Source_Status,1);
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Feed
+********************************************************************************/
+static void BL_Delta_Feed(uint8_t Data)
+{
+	uint32_t Source_Offset = 0;
+	uint16_t Length = 0;
+	
+	/* The rest of a broken patch is dropped, the host gets the failure */
+	if(FLASH_WRITE_PASSED != BL_Delta.Status)
+	{
+		return;
+	}
+	
+	switch(BL_Delta.State)
+	{
+		case BL_DELTA_OP:
+			BL_Delta.Op = Data;
+			BL_Delta.Args_Received = 0;
+			if(BL_DELTA_OP_COPY == Data)
+			{
+				BL_Delta.Args_Size = BL_DELTA_COPY_ARGS_SIZE;
+			}
+			else if(BL_DELTA_OP_INSERT == Data)
+			{
+				BL_Delta.Args_Size = BL_DELTA_INSERT_ARGS_SIZE;
+			}
+			else
+			{
+				BL_Delta.Status = FLASH_WRITE_FAILED;
+				break;
+			}
+			BL_Delta.State = BL_DELTA_ARGS;
+			break;
+		
+		case BL_DELTA_ARGS:
+			BL_Delta.Args[BL_Delta.Args_Received++] = Data;
+			if(BL_Delta.Args_Received < BL_Delta.Args_Size)
+			{
+				break;
+			}
+			if(BL_DELTA_OP_COPY == BL_Delta.Op)
+			{
+				memcpy(&Source_Offset,BL_Delta.Args,sizeof(Source_Offset));
+				Length = (uint16_t)(BL_Delta.Args[4] | (BL_Delta.Args[5] << 8));
+				while((0 != Length) && (FLASH_WRITE_PASSED == BL_Delta.Status))
+				{
+					/* The pages before the one being built are already overwritten */
+					if((Source_Offset < (BL_Delta.Output_Total - BL_Delta.Page_Len)) || (Source_Offset >= BL_APP_AREA_SIZE))
+					{
+						BL_Delta.Status = FLASH_WRITE_FAILED;
+						break;
+					}
+					BL_Delta_Put_Byte(*((uint8_t *)(APP_BASE_ADDREESS + Source_Offset)));
+					Source_Offset++;
+					Length--;
+				}
+				BL_Delta.State = BL_DELTA_OP;
+			}
+			else
+			{
+				BL_Delta.Insert_Left = (uint16_t)(BL_Delta.Args[0] | (BL_Delta.Args[1] << 8));
+				BL_Delta.State = (0 == BL_Delta.Insert_Left) ? BL_DELTA_OP : BL_DELTA_INSERT_DATA;
+			}
+			break;
+		
+		case BL_DELTA_INSERT_DATA:
+			BL_Delta_Put_Byte(Data);
+			BL_Delta.Insert_Left--;
+			if(0 == BL_Delta.Insert_Left)
+			{
+				BL_Delta.State = BL_DELTA_OP;
+			}
+			break;
+		
+		default:
+			break;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Put_Byte
+********************************************************************************/
+static void BL_Delta_Put_Byte(uint8_t Data)
+{
+	/* The patch builds more than the announced image */
+	if(BL_Delta.Output_Total >= BL_Delta.New_Length)
+	{
+		BL_Delta.Status = FLASH_WRITE_FAILED;
+		return;
+	}
+	if(0 == BL_Delta.Page_Len)
+	{
+		BL_Delta.Page = BL_Write_Pipeline_Get_Buffer();
+	}
+	BL_Delta.Page[BL_Delta.Page_Len++] = Data;
+	BL_Delta.Output_Total++;
+	
+	if(PAGE_SIZE == BL_Delta.Page_Len)
+	{
+		BL_Delta_Commit_Page();
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Commit_Page
+********************************************************************************/
+static void BL_Delta_Commit_Page(void)
+{
+	uint32_t Page_Address = APP_BASE_ADDREESS + BL_Delta.Output_Total - BL_Delta.Page_Len;
+	
+	/* The flash is programmed by half words, pad the last byte of the image */
+	if(BL_Delta.Page_Len & 0x01)
+	{
+		BL_Delta.Page[BL_Delta.Page_Len++] = 0xFF;
+	}
+	/* The page is in the scratch buffer so its old content isn't needed any more */
+	if(ERASE_SUCCESSFUL == BL_Perform_Page_Erase(Page_Address))
+	{
+		BL_Write_Pipeline_Commit(Page_Address,BL_Delta.Page_Len);
+	}
+	else
+	{
+		BL_Delta.Status = FLASH_WRITE_FAILED;
+	}
+	BL_Delta.Page_Len = 0;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Finish
+********************************************************************************/
+static uint8_t BL_Delta_Finish(void)
+{
+	uint8_t Write_Status = FLASH_WRITE_PASSED;
+	
+	/* Patch cut in the middle of an operation */
+	if(BL_DELTA_OP != BL_Delta.State)
+	{
+		BL_Delta.Status = FLASH_WRITE_FAILED;
+	}
+	if((FLASH_WRITE_PASSED == BL_Delta.Status) && (0 != BL_Delta.Page_Len))
+	{
+		BL_Delta_Commit_Page();
+	}
+	Write_Status = BL_Write_Pipeline_Flush();
+	if(FLASH_WRITE_PASSED != BL_Delta.Status)
+	{
+		Write_Status = FLASH_WRITE_FAILED;
+	}
+	else if((BL_Delta.Output_Total != BL_Delta.New_Length)
+		|| (BL_Delta.New_CRC != BL_CRC_Calculate_Region(APP_BASE_ADDREESS,BL_Delta.New_Length)))
+	{
+		BL_Print_Message("New Image CRC Mismatch \r\n");
+		Write_Status = BL_DELTA_CRC_MISMATCH;
+	}
+	BL_Delta.Active = 0;
+	
+	return Write_Status;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Data
+********************************************************************************/
+static void BL_Delta_Data(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Apply a delta patch frame \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		
+		uint16_t Payload_Len = 0;
+		uint8_t *Payload = BL_Get_Write_Payload(Hostbuffer,2,&Payload_Len);
+		uint8_t Reply[BL_DELTA_REPLY_LEN] = {FLASH_WRITE_FAILED};
+		if((0 != BL_Delta.Active) && (NULL != Payload))
+		{
+			if(0 == Payload_Len)
+			{
+				/* Empty packet ends the patch with the CRC check of the new image */
+				Reply[0] = BL_Delta_Finish();
+			}
+			else
+			{
+				for(uint16_t Counter = 0 ; Counter < Payload_Len ; Counter++)
+				{
+					BL_Delta_Feed(Payload[Counter]);
+				}
+				/* Report the failure only once */
+				Reply[0] = BL_Write_Status;
+				BL_Write_Status = FLASH_WRITE_PASSED;
+				if(FLASH_WRITE_PASSED != BL_Delta.Status)
+				{
+					Reply[0] = FLASH_WRITE_FAILED;
+				}
+			}
+		}
+		else
+		{
+			BL_Print_Message("No Delta Session or Invalid Length \r\n");
+		}
+		memcpy(Reply+1,&BL_Delta.Output_Total,sizeof(BL_Delta.Output_Total));
+		BL_Send_ACK_NACK(BL_OK,Reply,BL_DELTA_REPLY_LEN);
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Execute
+********************************************************************************/
+static void BL_Batch_Execute(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Execute a batch of commands \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		uint16_t Batch_End = Host_CMD_Packet_Len - CRC_BYTE_SIZE;
+		uint16_t Offset = BL_BATCH_FIRST_SUB_OFFSET;
+		uint8_t Options = Hostbuffer[2];
+		
+		BL_Batch.Active = 1;
+		BL_Batch.Reply[0] = 0;
+		BL_Batch.Reply[1] = BL_BATCH_COMPLETED;
+		BL_Batch.Reply_Len = BL_BATCH_REPLY_FIRST_ENTRY;
+		while(Offset < Batch_End)
+		{
+			uint8_t *Sub_Command = Hostbuffer + Offset;
+			uint16_t Entry_Offset = BL_Batch.Reply_Len;
+			uint8_t Reply_Max_Len = 0;
+			uint8_t Counter = 0;
+			
+			/* A sub-command is laid out like a v1 frame without its CRC */
+			if((0 == Sub_Command[0]) || (BL_FRAME_V2_MARKER == Sub_Command[0])
+				|| ((Offset + 1 + Sub_Command[0]) > Batch_End))
+			{
+				BL_Batch.Reply[1] = BL_BATCH_BAD_SUB_COMMAND;
+				break;
+			}
+			for(Counter = 0 ; Counter < (sizeof(BL_Batch_Commands) / sizeof(BL_Batch_Commands[0])) ; Counter++)
+			{
+				if(BL_Batch_Commands[Counter].Command == Sub_Command[1])
+				{
+					Reply_Max_Len = BL_Batch_Commands[Counter].Reply_Max_Len;
+					break;
+				}
+			}
+			/* The command may already change the flash, so its reply must fit before it runs */
+			if((BL_Batch.Reply_Len + BL_REPLY_HEADER_SIZE + Reply_Max_Len) > BL_REPLY_MAX_LEN)
+			{
+				BL_Batch.Reply[1] = BL_BATCH_REPLY_OVERFLOW;
+				break;
+			}
+			/* The handlers take the CRC after the arguments, the batch CRC already covers them */
+			BL_Host_Packet_Len = 1 + Sub_Command[0] + CRC_BYTE_SIZE;
+			if(Counter < (sizeof(BL_Batch_Commands) / sizeof(BL_Batch_Commands[0])))
+			{
+				BL_Execute_Command(Sub_Command);
+			}
+			else
+			{
+				BL_Send_ACK_NACK(BL_NACK,NULL,0);
+			}
+			if((Options & BL_BATCH_STOP_ON_ERROR)
+				&& BL_Batch_Command_Failed(Sub_Command[1],BL_Batch.Reply+Entry_Offset))
+			{
+				BL_Batch.Reply[1] = BL_BATCH_STOPPED_ON_ERROR;
+				break;
+			}
+			Offset += 1 + Sub_Command[0];
+		}
+		BL_Batch_Send_Reply();
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Capture
+********************************************************************************/
+static void BL_Batch_Capture(BL_Status BL_Message, uint8_t *Reply, uint8_t Reply_Len)
+{
+	uint8_t *Entry = BL_Batch.Reply + BL_Batch.Reply_Len;
+	
+	/* The batch checked the room for the longest reply of the command before it ran */
+	Entry[0] = (BL_OK == BL_Message) ? CBL_SEND_ACK : CBL_SEND_NACK;
+	Entry[1] = Reply_Len;
+	memcpy(Entry+BL_REPLY_HEADER_SIZE,Reply,Reply_Len);
+	BL_Batch.Reply_Len += BL_REPLY_HEADER_SIZE + Reply_Len;
+	BL_Batch.Reply[0]++;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Command_Failed
+********************************************************************************/
+static uint8_t BL_Batch_Command_Failed(uint8_t Command, uint8_t *Entry)
+{
+	uint8_t Failed = 0;
+	
+	if(CBL_SEND_ACK != Entry[0])
+	{
+		Failed = 1;
+	}
+	else if(0 != Entry[1])
+	{
+		/* Commands that reply with a status byte */
+		switch(Command)
+		{
+			case CBL_GO_TO_ADDR_CMD:
+				Failed = (ADDRESS_IS_VALID != Entry[BL_REPLY_HEADER_SIZE]);
+				break;
+			
+			case CBL_FLASH_ERASE_CMD:
+				Failed = (ERASE_SUCCESSFUL != Entry[BL_REPLY_HEADER_SIZE]);
+				break;
+			
+			case CBL_MEM_WRITE_CMD:
+			case CBL_MEM_FILL_CMD:
+				Failed = (FLASH_WRITE_PASSED != Entry[BL_REPLY_HEADER_SIZE]);
+				break;
+			
+			case CBL_IMAGE_END_CMD:
+				Failed = (BL_IMAGE_HASH_MATCH != Entry[BL_REPLY_HEADER_SIZE]);
+				break;
+			
+			/* Replies the CRC, or one ADDRESS_IS_INVALID byte for a bad range */
+			case CBL_REGION_CRC_CMD:
+				Failed = (CRC_BYTE_SIZE != Entry[1]);
+				break;
+			
+			default:
+				break;
+		}
+	}
+	return Failed;
+}
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Send_Reply
+********************************************************************************/
+static void BL_Batch_Send_Reply(void)
+{
+	if(BL_Batch.Active)
+	{
+		BL_Batch.Active = 0;
+		BL_Send_ACK_NACK(BL_OK,BL_Batch.Reply,(uint8_t)BL_Batch.Reply_Len);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_Change_Baud_Rate
+********************************************************************************/
+static void BL_Change_Baud_Rate(uint8_t *Hostbuffer)
+{
+	BL_Print_Message("Change the baud rate of the host link \r\n");
+	
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		uint32_t Baud_Rate = *((uint32_t *)(Hostbuffer+2));
+		uint8_t Baud_Status = BAUD_RATE_INVALID;
+		uint8_t Confirm_Byte = 0;
+		uint32_t Start_Tick = 0;
+		for(uint8_t i = 0 ; i < (sizeof(BL_Supported_Baud_Rates) / sizeof(BL_Supported_Baud_Rates[0])) ; i++)
+		{
+			/* A link without a speed to set (CAN, the pty of the native build) refuses every speed */
+			if((Baud_Rate == BL_Supported_Baud_Rates[i]) && (NULL != BL_Host_Transport->Set_Speed))
+			{
+				Baud_Status = BAUD_RATE_VALID;
+			}
+		}
+		/* The reply goes with the old speed, the switch waits for its last stop bit */
+		BL_Send_ACK_NACK(BL_OK,&Baud_Status,1);
+		if(BAUD_RATE_VALID == Baud_Status)
+		{
+			BL_Host_Transport->Set_Speed(Baud_Rate);
+			/* Keep the new speed only if the host sends the confirm byte with it */
+			Baud_Status = BAUD_RATE_INVALID;
+			Start_Tick = HAL_GetTick();
+			while((HAL_GetTick() - Start_Tick) < BL_BAUD_CONFIRM_TIMEOUT)
+			{
+				if((HAL_OK == BL_Receive_Data_From_Host(&Confirm_Byte,1,BL_BAUD_CONFIRM_TIMEOUT))
+					&& (BL_BAUD_CONFIRM_BYTE == Confirm_Byte))
+				{
+					Baud_Status = BAUD_RATE_VALID;
+					break;
+				}
+			}
+			if(BAUD_RATE_VALID == Baud_Status)
+			{
+				BL_Print_Message("Baud Rate Changed to %d \r\n",Baud_Rate);
+				BL_Host_Transport->Send(&Confirm_Byte,1);
+				/* The next failed change comes back to this speed */
+				BL_Host_Baud_Rate = Baud_Rate;
+			}
+			else
+			{
+				BL_Print_Message("No Confirmation, Back to %d \r\n",BL_Host_Baud_Rate);
+				BL_Host_Transport->Set_Speed(BL_Host_Baud_Rate);
+			}
+		}
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
-	return (RDP_Value) ;
 }
 
 /*******************************************************************************
-* Function Name:		BL_Get_Read_Protection_Level
+* Function Name:		BL_Get_Link_Stats
 ********************************************************************************/
-static void BL_Get_Read_Protection_Level(uint8_t *Hostbuffer)
+static void BL_Get_Link_Stats(uint8_t *Hostbuffer)
 {
-	BL_Print_Message("Read the flash read protection level \r\n");
-
+	BL_Print_Message("Read the host link statistics \r\n");
+	
 	/* Get the CRC value and the length sent by the user */
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
 	/* CRC Verification */
 	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
 		BL_Print_Message("CRC Verification Passed \r\n");
-		BL_Send_ACK_NACK(BL_OK,1);
-		uint8_t RDP_Level = BL_GET_RDP_LEVEL();
-		
-		BL_Send_Data_To_Host((uint8_t *)&RDP_Level,1);
+		uint32_t Link_Stats[2] = {BL_Framing_Resyncs,BL_Framing_Timeouts};
+		/* Frames the link itself dropped (a broken ISO-TP message, an overrun uart ring) count as resyncs */
+		if(NULL != BL_Host_Transport->Get_Errors)
+		{
+			Link_Stats[0] += BL_Host_Transport->Get_Errors();
+		}
+		BL_Send_ACK_NACK(BL_OK,(uint8_t *)Link_Stats,sizeof(Link_Stats));
 	}
 	else
 	{
 		BL_Print_Message("CRC Verification Failed \r\n");
-		BL_Send_ACK_NACK(BL_NACK,0);
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
 }
 
 /*******************************************************************************
-* Function Name:		BL_Host_Jump_Address_Verify
+* Function Name:		BL_Set_CRC_Mode
 ********************************************************************************/
-static uint8_t BL_Host_Jump_Address_Verify(uint32_t Jump_Address)
+static void BL_Set_CRC_Mode(uint8_t *Hostbuffer)
 {
-	uint8_t Address_Verification = ADDRESS_IS_INVALID;
+	BL_Print_Message("Change the CRC mode \r\n");
 	
-	if( ((Jump_Address >= STM32F103_SRAM_START) && (Jump_Address <= STM32F103_SRAM_END)) \
-		|| ((Jump_Address >= STM32F103_FLASH_START) && (Jump_Address <= STM32F103_FLASH_END)))
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
+	
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
-		Address_Verification = ADDRESS_IS_VALID;
+		BL_Print_Message("CRC Verification Passed \r\n");
+		uint8_t CRC_Mode = Hostbuffer[2];
+		uint8_t Mode_Status = CRC_MODE_INVALID;
+		if((BL_CRC_MODE_V1 == CRC_Mode) || (BL_CRC_MODE_V2 == CRC_Mode))
+		{
+			Mode_Status = CRC_MODE_VALID;
+		}
+		/* The reply is checked with the old mode, the next frame with the new one */
+		BL_Send_ACK_NACK(BL_OK,&Mode_Status,1);
+		if(CRC_MODE_VALID == Mode_Status)
+		{
+			BL_CRC_Mode = CRC_Mode;
+			BL_Print_Message("CRC Mode v%d \r\n",BL_CRC_Mode);
+		}
 	}
 	else
 	{
-		Address_Verification = ADDRESS_IS_INVALID;
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
-	return Address_Verification;
-}
-
-/*******************************************************************************
-* Function Name:		BL_Jump_To_User_App
-********************************************************************************/
-static void BL_Jump_To_User_App(void)
-{
-	/* Value if the main stack pointer of our main application */
-	uint32_t MSP_Value = *((volatile uint32_t *)APP_BASE_ADDREESS);
-	
-	/* Reset handler definition function of our main application */
-	uint32_t MainAppAddr = *((volatile uint32_t *)(APP_BASE_ADDREESS+4));
-	pFunction APP_ResetHandler_Address = (pFunction)MainAppAddr;
-	
-	/* Set the main stack pointer to its value */
-	__set_MSP(MSP_Value);
-	
-	/* Deintialization of module */
-	HAL_RCC_DeInit(); /* Reset the RCC clock configuration to the deafult reset state */
-	
-	/* Jump to application reset handler */
-	APP_ResetHandler_Address();
 }
 
 /*******************************************************************************
-* Function Name:		BL_Jump_To_Address
+* Function Name:		BL_Region_CRC
 ********************************************************************************/
-static void BL_Jump_To_Address(uint8_t *Hostbuffer)
+static void BL_Region_CRC(uint8_t *Hostbuffer)
 {
-	BL_Print_Message("Jump bootloader to specified address \r\n");
+	BL_Print_Message("Calculate the CRC of a flash region \r\n");
 	
 	/* Get the CRC value and the length sent by the user */
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
-	/* Extract the jump address and verify it */
-	uint32_t Host_Jump_Address = *((uint32_t *)(Hostbuffer+2));
-	
-		/* CRC Verification */
-		if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
+	{
+		BL_Print_Message("CRC Verification Passed \r\n");
+		uint32_t Start_Address = *((uint32_t *)(Hostbuffer+2));
+		uint32_t Length = *((uint32_t *)(Hostbuffer+6));
+		uint32_t Region_CRC = 0;
+		uint8_t Address_Verification = ADDRESS_IS_INVALID;
+		if((0 != Length) && (Start_Address >= STM32F103_FLASH_START) && (Start_Address < STM32F103_FLASH_END)
+			&& (Length <= (STM32F103_FLASH_END - Start_Address)))
 		{
-			
-			BL_Print_Message("CRC Verification Passed \r\n");
-			BL_Send_ACK_NACK(BL_OK,1);
-			
-			uint8_t Address_Verification = BL_Host_Jump_Address_Verify(Host_Jump_Address);
-			if(ADDRESS_IS_VALID == Address_Verification)
-			{
-				BL_Print_Message("Address Verification Passed \r\n");
-				BL_Send_Data_To_Host(&Address_Verification,1);
-				/* If we received this specific address we will assume that the user want
-				 * to end the bootloader and go to the app */
-				if( Host_Jump_Address == APP_BASE_ADDREESS )
-				{
-					BL_Jump_To_User_App();
-				}
-				if((Host_Jump_Address & 0x01) == 0)
-				{
-					/* To ensure that the function address LSB = one which stands for Thumb state  */
-					Host_Jump_Address++;
-				} 
-				pFunction Jump_Address = (pFunction)Host_Jump_Address ;
-				Jump_Address();
-			}
-			else
-			{
-				BL_Print_Message("Address Verification Failed \r\n");
-				BL_Send_Data_To_Host(&Address_Verification,1);
-			}
+			/* Same CRC mode as the frames, the host compares it with its image */
+			Region_CRC = BL_CRC_Calculate_Region(Start_Address,Length);
+			BL_Send_ACK_NACK(BL_OK,(uint8_t *)&Region_CRC,CRC_BYTE_SIZE);
 		}
 		else
 		{
-			BL_Print_Message("CRC Verification Failed \r\n");
-			BL_Send_ACK_NACK(BL_NACK,0);
-		}	
+			BL_Print_Message("Address Verification Failed \r\n");
+			BL_Send_ACK_NACK(BL_OK,&Address_Verification,1);
+		}
+	}
+	else
+	{
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
 }
 
 /*******************************************************************************
-* Function Name:		BL_Perform_Flash_Erase
+* Function Name:		BL_Page_Range_Verify
 ********************************************************************************/
-static uint8_t BL_Perform_Flash_Erase(uint8_t Sector_Number, uint8_t Number_Of_Sectors)
+static uint8_t BL_Page_Range_Verify(uint16_t First_Page, uint16_t Pages_Number)
 {
-	uint8_t Erase_Status = ERASE_UNSUCCESSFUL;
-	if(( (Number_Of_Sectors+Sector_Number) <= MAX_SECTOR_NUMBER ) || (ERASE_ALL_COMMAND == Sector_Number))
-	{
-		FLASH_EraseInitTypeDef pEraseInit;
-		uint32_t PageError;
-		if((Number_Of_Sectors+Sector_Number) <= MAX_SECTOR_NUMBER)
-		{
-			pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-		}
-		else
-		{
-			pEraseInit.TypeErase = FLASH_TYPEERASE_MASSERASE;
-		}
-		pEraseInit.Banks = FLASH_BANK_1;
-		pEraseInit.PageAddress = STM32F103_FLASH_START + (PAGE_SIZE*PAGES_PER_SECTOR*Sector_Number);
-		pEraseInit.NbPages = Number_Of_Sectors * PAGES_PER_SECTOR;
-		
-		/* Start Erasing */
-		HAL_FLASH_Unlock();
-		HAL_FLASHEx_Erase(&pEraseInit,&PageError);
-		HAL_FLASH_Lock();
-		
-		if(PAGE_ERASE_SUCCESS == PageError)
-		{
-			Erase_Status = ERASE_SUCCESSFUL;
-		}
-		else
-		{
-			Erase_Status = ERASE_UNSUCCESSFUL;
-		}
-	}
-	else
+	uint8_t Address_Verification = ADDRESS_IS_INVALID;
+	if((0 != Pages_Number) && (First_Page < BL_APP_PAGES_NUMBER) && (Pages_Number <= (BL_APP_PAGES_NUMBER - First_Page)))
 	{
-		Erase_Status = SECTOR_NUMBER_INVALID;
+		Address_Verification = ADDRESS_IS_VALID;
 	}
-	return Erase_Status;
+	return Address_Verification;
 }
 
 /*******************************************************************************
-* Function Name:		BL_Erase_Flash
+* Function Name:		BL_Page_CRC
 ********************************************************************************/
-static void BL_Erase_Flash(uint8_t *Hostbuffer)
+static void BL_Page_CRC(uint8_t *Hostbuffer)
 {
-	BL_Print_Message("Mass erase or sector erase of user flash \r\n");
+	BL_Print_Message("Calculate the CRC of every application page \r\n");
 	
 	/* Get the CRC value and the length sent by the user */
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
-	uint8_t Erase_Status = 0;
 	
 	/* CRC Verification */
 	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
 		BL_Print_Message("CRC Verification Passed \r\n");
-		BL_Send_ACK_NACK(BL_OK,1);
-		
-		/* Erase the required secotrs */
-		Erase_Status = BL_Perform_Flash_Erase(Hostbuffer[2],Hostbuffer[3]);
-		if(ERASE_SUCCESSFUL == Erase_Status)
+		uint16_t First_Page = *((uint16_t *)(Hostbuffer+2));
+		uint16_t Pages_Number = *((uint16_t *)(Hostbuffer+4));
+		uint32_t Page_CRCs[BL_PAGE_CRC_MAX_PAGES];
+		uint8_t Address_Verification = BL_Page_Range_Verify(First_Page,Pages_Number);
+		if((ADDRESS_IS_VALID == Address_Verification) && (Pages_Number <= BL_PAGE_CRC_MAX_PAGES))
 		{
-			BL_Print_Message("Erase Is Done \r\n");
-			BL_Send_Data_To_Host(&Erase_Status,1);
+			for(uint16_t Page = 0 ; Page < Pages_Number ; Page++)
+			{
+				Page_CRCs[Page] = BL_CRC_Calculate_Region(APP_BASE_ADDREESS + ((uint32_t)(First_Page + Page) * PAGE_SIZE),PAGE_SIZE);
+			}
+			BL_Send_ACK_NACK(BL_OK,(uint8_t *)Page_CRCs,Pages_Number * CRC_BYTE_SIZE);
 		}
 		else
 		{
-			BL_Print_Message("Erase Failed \r\n");
-			BL_Send_Data_To_Host(&Erase_Status,1);
+			BL_Print_Message("Page Range Verification Failed \r\n");
+			Address_Verification = ADDRESS_IS_INVALID;
+			BL_Send_ACK_NACK(BL_OK,&Address_Verification,1);
 		}
-		
 	}
 	else
 	{
 		BL_Print_Message("CRC Verification Failed \r\n");
-		BL_Send_ACK_NACK(BL_NACK,0);
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
 }
 
 /*******************************************************************************
-* Function Name:		BL_Write_Payload_In_Flash
+* Function Name:		BL_Page_Erase
 ********************************************************************************/
-static uint8_t BL_Write_Payload_In_Flash(uint8_t *Host_Payload, uint32_t Start_Address, uint8_t Payload_Len)
+static void BL_Page_Erase(uint8_t *Hostbuffer)
 {
-	HAL_StatusTypeDef HAL_Status = HAL_ERROR;
-	uint16_t Payload_Counter = 0;
-	uint8_t Write_Status = FLASH_WRITE_FAILED;
+	BL_Print_Message("Erase application pages \r\n");
 	
-	/* Unlock the flash memory */
-	HAL_Status = HAL_FLASH_Unlock();
+	/* Get the CRC value and the length sent by the user */
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
+	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
-	if(HAL_OK != HAL_Status)
-	{
-		Write_Status = FLASH_WRITE_FAILED;
-	}
-	else
+	/* CRC Verification */
+	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
-		/* If unlock passed then write the flash */
-		for(Payload_Counter = 0 ; Payload_Counter < Payload_Len ; Payload_Counter+= 2)
+		BL_Print_Message("CRC Verification Passed \r\n");
+		uint16_t First_Page = *((uint16_t *)(Hostbuffer+2));
+		uint16_t Pages_Number = *((uint16_t *)(Hostbuffer+4));
+		uint8_t Erase_Status = SECTOR_NUMBER_INVALID;
+		if(ADDRESS_IS_VALID == BL_Page_Range_Verify(First_Page,Pages_Number))
 		{
-			HAL_Status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,Start_Address+Payload_Counter,*((uint16_t*)(&Host_Payload[Payload_Counter])));
-			if(HAL_OK != HAL_Status)
+			Erase_Status = ERASE_SUCCESSFUL;
+			for(uint16_t Page = First_Page ; (Page < (First_Page + Pages_Number)) && (ERASE_SUCCESSFUL == Erase_Status) ; Page++)
 			{
-				break;
+				Erase_Status = BL_Perform_Page_Erase(APP_BASE_ADDREESS + ((uint32_t)Page * PAGE_SIZE));
 			}
 		}
-		//HAL_Status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD,0x08008000,0xBBAA);
-		
-	}
-	
-	if(HAL_OK != HAL_Status)
-	{
-		Write_Status = FLASH_WRITE_FAILED;
+		else
+		{
+			BL_Print_Message("Page Range Verification Failed \r\n");
+		}
+		BL_Send_ACK_NACK(BL_OK,&Erase_Status,1);
 	}
 	else
 	{
-		Write_Status = FLASH_WRITE_PASSED;
+		BL_Print_Message("CRC Verification Failed \r\n");
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
-	
-	HAL_Status = HAL_FLASH_Lock();
-	
-	return Write_Status;
 }
 
 /*******************************************************************************
-* Function Name:		BL_Memory_Write
+* Function Name:		BL_Image_End
 ********************************************************************************/
-static void BL_Memory_Write(uint8_t *Hostbuffer)
+static void BL_Image_End(uint8_t *Hostbuffer)
 {
-	BL_Print_Message("Write data into different memories of the MCU \r\n");
+	BL_Print_Message("Compare the CRC of the written image \r\n");
 	
 	/* Get the CRC value and the length sent by the user */
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
 	/* CRC Verification */
 	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
 		BL_Print_Message("CRC Verification Passed \r\n");
-		BL_Send_ACK_NACK(BL_OK,1);
-		
-		/* Extract the start address and the payload length */
-		uint32_t Start_Address = *((uint32_t *)(Hostbuffer+2)) ;
-		uint8_t Payload_Len = Hostbuffer[6];
-		uint8_t Address_Verification = BL_Host_Jump_Address_Verify(Start_Address);
-		if(ADDRESS_IS_VALID == Address_Verification)
+		uint32_t Image_Length = *((uint32_t *)(Hostbuffer+2));
+		uint32_t Image_CRC = *((uint32_t *)(Hostbuffer+6));
+		uint32_t End_Address = APP_BASE_ADDREESS + Image_Length;
+		uint8_t Reply[BL_IMAGE_END_REPLY_LEN] = {BL_IMAGE_HASH_INVALID,0,0,0,0};
+		if((BL_Image_Hash.Active) && (Image_Length <= BL_APP_AREA_SIZE))
 		{
-			BL_Print_Message("Address Verification Passed \r\n");
-			uint8_t Write_Status = BL_Write_Payload_In_Flash(Hostbuffer+7,Start_Address,Payload_Len);
-			if(FLASH_WRITE_PASSED == Write_Status)
+			if((BL_Image_Hash.Out_Of_Order) || (End_Address < BL_Image_Hash.Next_Address))
 			{
-				BL_Print_Message("Wite Successed \r\n");
-				BL_Send_Data_To_Host(&Write_Status,1);
+				uint8_t CRC_Mode = BL_CRC_Mode;
+				/* The running CRC is stale or past the image end, read the image once as the trailer check */
+				BL_CRC_Mode = BL_APP_CRC_MODE;
+				BL_Image_Hash.CRC_Value = BL_CRC_Calculate_Region(APP_BASE_ADDREESS,Image_Length);
+				BL_CRC_Mode = CRC_Mode;
 			}
 			else
 			{
-				BL_Print_Message("Wite Failed \r\n");
-				BL_Send_Data_To_Host(&Write_Status,1);
+				/* The erased flash the host didn't write up to the image end, then the 1 to 3 tail bytes one word each */
+				BL_Image_Hash_Feed(End_Address);
+				BL_CRC_Seed(BL_Image_Hash.CRC_Value);
+				for(uint32_t Index = 0 ; Index < (End_Address % 4) ; Index++)
+				{
+					BL_CRC_WRITE((BL_Image_Hash.Pending >> (8 * Index)) & 0xFF);
+				}
+				BL_Image_Hash.CRC_Value = BL_CRC_READ();
+				BL_CRC_RESET();
 			}
+			/* The image ended the stream, the next image starts again */
+			BL_Image_Hash.Active = 0;
+			Reply[0] = (Image_CRC == BL_Image_Hash.CRC_Value) ? BL_IMAGE_HASH_MATCH : BL_IMAGE_HASH_MISMATCH;
+			memcpy(&Reply[1],&BL_Image_Hash.CRC_Value,CRC_BYTE_SIZE);
 		}
 		else
 		{
-			BL_Print_Message("Address Verification Failed \r\n");
-			BL_Send_Data_To_Host(&Address_Verification,1);
+			BL_Print_Message("Image Hash Invalid \r\n");
 		}
+		BL_Send_ACK_NACK(BL_OK,Reply,BL_IMAGE_END_REPLY_LEN);
 	}
 	else
 	{
 		BL_Print_Message("CRC Verification Failed \r\n");
-		BL_Send_ACK_NACK(BL_NACK,0);
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
 	}
 }
 
@@ -685,25 +2821,143 @@ static void BL_Change_Read_Protection_Level(uint8_t *Hostbuffer)
 	BL_Print_Message("Change read protection on different sectors of the user flash \r\n");
 
 	/* Get the CRC value and the length sent by the user */
-	uint16_t Host_CMD_Packet_Len = Hostbuffer[0]+1;
+	uint16_t Host_CMD_Packet_Len = BL_Host_Packet_Len;
 	uint32_t Host_CRC32 = *((uint32_t *)(Hostbuffer+Host_CMD_Packet_Len-CRC_BYTE_SIZE));
 	
 	/* CRC Verification */
 	if(CRC_OK == BL_CRC_Verify(Hostbuffer, Host_CMD_Packet_Len - CRC_BYTE_SIZE, Host_CRC32))
 	{
 		BL_Print_Message("CRC Verification Passed \r\n");
-		BL_Send_ACK_NACK(BL_OK,1);
 		uint8_t ROP_Status = BL_Change_ROP_Level(Hostbuffer[2]);
-		BL_Send_Data_To_Host(&ROP_Status,1);
+		BL_Send_ACK_NACK(BL_OK,&ROP_Status,1);
 		
-		/* Lauch the option byte to apply the changes */
+		/* Lauch the option byte to apply the changes, it resets the MCU so send the reply first */
+		BL_Host_Transport->Flush();
 		HAL_FLASH_OB_Launch();
 	}
 	else
 	{
 		BL_Print_Message("CRC Verification Failed \r\n");
-		BL_Send_ACK_NACK(BL_NACK,0);
+		BL_Send_ACK_NACK(BL_NACK,NULL,0);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_CRC_Calculate
+********************************************************************************/
+static uint32_t BL_CRC_Calculate(uint8_t *pData, uint32_t Data_Len)
+{
+	uint32_t CRC_Value = 0;
+	uint32_t Index = 0;
+	/* v2 : one register write per word, the frames are not word aligned in the buffer */
+	if(BL_CRC_MODE_V2 == BL_CRC_Mode)
+	{
+		for( ; (Data_Len - Index) >= 4 ; Index += 4)
+		{
+			BL_CRC_WRITE(__UNALIGNED_UINT32_READ(pData+Index));
+		}
+	}
+	/* v1 and the v2 tail : one word per byte */
+	for( ; Index < Data_Len ; Index++)
+	{
+		BL_CRC_WRITE((uint32_t)pData[Index]);
+	}
+	CRC_Value = BL_CRC_READ();
+	/* Reset the CRC Engine to use it again as we use CRC accumlation */
+	BL_CRC_RESET();
+	return CRC_Value;
+}
+
+/*******************************************************************************
+* Function Name:		BL_CRC_Calculate_Region
+********************************************************************************/
+static uint32_t BL_CRC_Calculate_Region(uint32_t Address, uint32_t Length)
+{
+	DMA_HandleTypeDef *CRC_DMA = CRC_DMA_OBJ;
+	uint32_t Region_Address = Address;
+	uint32_t Region_Length = Length;
+	uint32_t Unit_Size = 1;
+	uint32_t Transfers = 0;
+	uint32_t Tick_Start = 0;
+	uint32_t CRC_Value = 0;
+	uint32_t Read_Size = DMA_PDATAALIGN_BYTE;
+	HAL_StatusTypeDef DMA_Status = HAL_OK;
+	if(BL_CRC_MODE_V2 == BL_CRC_Mode)
+	{
+		/* The DMA can't read a word from an unaligned address */
+		if(0 != (Address % 4))
+		{
+			return BL_CRC_Calculate((uint8_t *)Address,Length);
+		}
+		Unit_Size = 4;
+		Read_Size = DMA_PDATAALIGN_WORD;
+	}
+	/* The channel is set up once by MX_DMA_Init, only the read size follows the mode,
+	 * v1 reads a byte and writes it to CRC->DR zero extended to a word */
+	__HAL_DMA_DISABLE(CRC_DMA);
+	MODIFY_REG(CRC_DMA->Instance->CCR,DMA_CCR_PSIZE,Read_Size);
+	CRC_DMA->Init.PeriphDataAlignment = Read_Size;
+	while(Length >= Unit_Size)
+	{
+		Transfers = Length / Unit_Size;
+		if(Transfers > BL_CRC_DMA_MAX_TRANSFERS)
+		{
+			Transfers = BL_CRC_DMA_MAX_TRANSFERS;
+		}
+		Tick_Start = HAL_GetTick();
+		DMA_Status = HAL_DMA_Start_IT(CRC_DMA,Address,(uint32_t)&(CRC_ENGINE_OBJ)->Instance->DR,Transfers);
+		if(HAL_OK == DMA_Status)
+		{
+			/* The transfer complete interrupt ends it, meanwhile the host link is polled
+			 * so the CAN fifo is drained and an overrun uart ring is seen */
+			while((HAL_DMA_STATE_BUSY == HAL_DMA_GetState(CRC_DMA))
+				&& ((HAL_GetTick() - Tick_Start) <= BL_CRC_DMA_TIMEOUT))
+			{
+				BL_Host_Rx_Available();
+			}
+		}
+		if((HAL_OK != DMA_Status) || (HAL_DMA_STATE_READY != HAL_DMA_GetState(CRC_DMA))
+			|| (HAL_DMA_ERROR_NONE != HAL_DMA_GetError(CRC_DMA)))
+		{
+			/* Start again on the CPU, the engine holds a partial CRC */
+			HAL_DMA_Abort(CRC_DMA);
+			BL_CRC_RESET();
+			return BL_CRC_Calculate((uint8_t *)Region_Address,Region_Length);
+		}
+		Address += Transfers * Unit_Size;
+		Length -= Transfers * Unit_Size;
 	}
+	/* v2 tail : one word per byte */
+	for( ; Length > 0 ; Length--)
+	{
+		BL_CRC_WRITE((uint32_t)(*((uint8_t *)Address)));
+		Address++;
+	}
+	CRC_Value = BL_CRC_READ();
+	/* Reset the CRC Engine to use it again as we use CRC accumlation */
+	BL_CRC_RESET();
+	return CRC_Value;
+}
+
+/*******************************************************************************
+* Function Name:		BL_CRC_Seed
+********************************************************************************/
+static void BL_CRC_Seed(uint32_t CRC_Value)
+{
+	uint8_t Bit = 0;
+	/* Undo the 32 shifts of a word, a set LSB means the polynomial was added after the shift */
+	for(Bit = 0 ; Bit < 32 ; Bit++)
+	{
+		if(CRC_Value & 0x01)
+		{
+			CRC_Value = ((CRC_Value ^ BL_CRC_POLYNOMIAL) >> 1) | 0x80000000;
+		}
+		else
+		{
+			CRC_Value >>= 1;
+		}
+	}
+	BL_CRC_WRITE(CRC_Value ^ BL_CRC_RESET_VALUE);
 }
 
 /*******************************************************************************
@@ -713,14 +2967,12 @@ static uint8_t BL_CRC_Verify(uint8_t *pData, uint32_t Data_Len, uint32_t Host_CR
 {
 	uint8_t CRC_Status = CRC_NOK;
 	uint32_t CRC_RECEIVED_DATA = 0;
-	/* Calculate CRC */
-	for(uint16_t i = 0 ; i < Data_Len ; i++)
+	/* The sub-commands of a batch are covered by the CRC of the batch frame */
+	if(BL_Batch.Active)
 	{
-		uint32_t Data_Buffer = (uint32_t)pData[i];
-		CRC_RECEIVED_DATA = HAL_CRC_Accumulate(CRC_ENGINE_OBJ,&Data_Buffer,1);
+		return CRC_OK;
 	}
-	/* Reset the CRC Engine to use it again as we use CRC accumlation */
-	__HAL_CRC_DR_RESET(CRC_ENGINE_OBJ);
+	CRC_RECEIVED_DATA = BL_CRC_Calculate(pData,Data_Len);
 	/* Compare the calculated CRC with the host CRC*/
 	if(CRC_RECEIVED_DATA == Host_CRC )
 	{
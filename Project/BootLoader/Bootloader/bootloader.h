@@ -37,12 +37,59 @@ typedef void(*pFunction)(void) ;
 *******************************************************************************/
 #define BL_DEBUG_UART												&huart2
 #define BL_HOST_COMMUNICATION_UART					&huart1
+#define BL_HOST_COMMUNICATION_CAN						&hcan
+#ifdef BL_NATIVE_BUILD
+#define BL_HOST_TRANSPORT										BL_PTY_Transport	/* Linux pseudo-terminal (Native/Makefile) */
+#else
+#define BL_HOST_TRANSPORT										BL_UART_Transport	/* or BL_CAN_Transport */
+#endif
 #define BL_ENABLE_UART_DEBUG_MESSAGE
+#define BL_ENABLE_REPLY_CRC									/* CRC32 at the end of every reply frame */
+/* Opt-in, the applications written before them have no trailer or signature (see the README) */
+/* #define BL_ENABLE_APP_IMAGE_CHECK */					/* no jump to an application without a valid trailer */
+/* #define BL_ENABLE_APP_SIGNATURE_CHECK */			/* the image must also be signed with your key (needs the image check and bootloader_key.c) */
+#if defined(BL_ENABLE_APP_SIGNATURE_CHECK) && !defined(BL_ENABLE_APP_IMAGE_CHECK)
+#error "BL_ENABLE_APP_SIGNATURE_CHECK needs BL_ENABLE_APP_IMAGE_CHECK, the jump command checks the image before it replies"
+#endif
 
-#define BL_HOST_BUFFER_SIZE									200
+#define BL_HOST_BUFFER_SIZE									(PAGE_SIZE+16)	/* a page of payload and the v2 header */
+#define BL_HOST_RX_RING_SIZE								4096	/* rx buffer of the host link (uart DMA or CAN) */
+#define BL_HOST_TX_QUEUE_SIZE								256		/* replies waiting for the tx DMA */
 
 #define CRC_BYTE_SIZE												4
 #define CRC_ENGINE_OBJ											&hcrc
+#define CRC_DMA_OBJ													&hdma_memtomem_dma1_channel1	/* flash to CRC->DR */
+#define BL_CRC_DMA_MAX_TRANSFERS						0xFFFF	/* 16 bit DMA counter */
+#define BL_CRC_DMA_TIMEOUT									100		/* ms for one DMA transfer */
+/* CRC engine data register, the native build has no engine behind CRC->DR and replaces them */
+#ifndef BL_CRC_WRITE
+#define BL_CRC_WRITE(Value)									((CRC_ENGINE_OBJ)->Instance->DR = (Value))
+#define BL_CRC_READ()												((CRC_ENGINE_OBJ)->Instance->DR)
+#define BL_CRC_RESET()											__HAL_CRC_DR_RESET(CRC_ENGINE_OBJ)
+#endif
+
+/*******************************************************************************
+*                        		Frames                                   		 		 *
+*******************************************************************************/
+/* v1 frame : [Length][Command][Arguments][CRC32], Length = bytes after it
+ * v2 frame : [0xFF][Length Low][Length High][Command][Arguments][CRC32], the CRC
+ *            skips the two length bytes and the write payload length is 16 bit */
+#define BL_FRAME_V2_MARKER									0xFF
+#define BL_FRAME_V2_HEADER_SIZE							3
+#define BL_FRAME_V2_LENGTH_SIZE							2
+
+/* COBS frame : [0x00][COBS encoded v1 or v2 frame][0x00], the delimiter never shows
+ * inside the frame so a corrupted frame is dropped at the next delimiter */
+#define BL_FRAME_COBS_DELIMITER							0x00
+#define BL_COBS_MAX_CODE										0xFF	/* a full block, no zero after it */
+#define BL_FRAMING_RAW											0x00
+#define BL_FRAMING_COBS											0x01	/* latched by the first valid COBS frame */
+
+/* A started frame is dropped with a NACK when the host goes quiet */
+#define BL_PARSER_BYTE_TIMEOUT							5			/* ms between two bytes of a frame */
+#define BL_PARSER_FRAME_TIMEOUT							2000	/* ms for a whole frame, a page at 9600 baud */
+#define BL_CAN_BYTE_TIMEOUT									20		/* a flow control round trip may sit between two bytes */
+#define BL_PTY_BYTE_TIMEOUT									50		/* the native build shares the CPU with the host */
 
 /*******************************************************************************
 *                        		BL Commands                                   		 *
@@ -59,6 +106,20 @@ typedef void(*pFunction)(void) ;
 #define CBL_READ_SECTOR_STATUS_CMD						0x19
 #define CBL_OTP_READ_CMD											0x20
 #define CBL_CHANGE_ROP_LEVEL_CMD							0x21
+#define CBL_MEM_WRITE_WINDOW_CMD							0x22
+#define CBL_MEM_WRITE_SEQ_CMD									0x23
+#define CBL_CHANGE_BAUD_CMD										0x24
+#define CBL_GET_LINK_STATS_CMD								0x25
+#define CBL_MEM_WRITE_COMPRESSED_CMD					0x26
+#define CBL_DELTA_START_CMD										0x27
+#define CBL_DELTA_DATA_CMD										0x28
+#define CBL_MEM_FILL_CMD											0x29
+#define CBL_BATCH_CMD													0x2A
+#define CBL_SET_CRC_MODE_CMD									0x2B
+#define CBL_REGION_CRC_CMD										0x2C
+#define CBL_PAGE_CRC_CMD											0x2D
+#define CBL_PAGE_ERASE_CMD										0x2E
+#define CBL_IMAGE_END_CMD											0x2F
 
 /*******************************************************************************
 *                        		Version	 		                                  		 *
@@ -73,18 +134,32 @@ typedef void(*pFunction)(void) ;
 *******************************************************************************/
 #define CRC_OK															1
 #define CRC_NOK															0
+#define BL_CRC_POLYNOMIAL										0x04C11DB7
+#define BL_CRC_RESET_VALUE									0xFFFFFFFF
+
+/* v1 : every byte goes to the CRC engine widened to a word
+ * v2 : the data as little endian words written straight to CRC->DR, the 1 to 3
+ *      tail bytes (Length % 4) then go one word each as in v1 */
+#define BL_CRC_MODE_V1											0x01
+#define BL_CRC_MODE_V2											0x02
+#define CRC_MODE_INVALID										0x00
+#define CRC_MODE_VALID											0x01
 
 /*******************************************************************************
 *                        		ACK VALUES	 		                                 	 *
 *******************************************************************************/
 #define CBL_SEND_NACK												0xAB
 #define CBL_SEND_ACK												0xCD
+/* Reply frame : [ACK or NACK][Length][Payload][CRC32], Length counts the payload only */
+#define BL_REPLY_HEADER_SIZE								2
+#define BL_REPLY_MAX_LEN										128		/* room for the replies of a whole batch */
 
 /*******************************************************************************
 *                        		ADDRESS VALIDATION	 		                        	 *
 *******************************************************************************/
 #define ADDRESS_IS_INVALID									0x00
 #define ADDRESS_IS_VALID										0x01
+#define ADDRESS_APP_IMAGE_INVALID						0x02	/* jump to the application refused */
 #define STM32F103_SRAM_START								(0x20000000)
 #define STM32F103_SRAM_END									(STM32F103_SRAM_START+(20*1024))
 #define STM32F103_FLASH_START								(0x08000000)
@@ -109,6 +184,132 @@ typedef void(*pFunction)(void) ;
 *******************************************************************************/
 #define FLASH_WRITE_FAILED									0x00
 #define FLASH_WRITE_PASSED									0x01
+#define FLASH_ERASED_HALF_WORD							0xFFFF
+
+/* Fill : [Start Address (4)][Length (4)][Pattern Size (2 or 4)][Pattern (4)], the pattern
+ * repeats from the start address and the range must be erased like for the memory write */
+#define BL_FILL_FRAME_LEN									19		/* [Len][Command], the 13 argument bytes and the CRC */
+#define BL_FILL_BLOCK_SIZE									32		/* pattern block programmed at a time, multiple of 4 */
+#define BL_FILL_PATTERN_HALF_WORD						2
+#define BL_FILL_PATTERN_WORD								4
+/* The fill never touches the BL, with the signature check it stays in the application area
+ * like the memory write so it can't forge a validated record in the metadata page */
+#define BL_FILL_START_ADDRESS								APP_BASE_ADDREESS
+#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+#define BL_FILL_END_ADDRESS									BL_METADATA_PAGE_ADDRESS
+#else
+#define BL_FILL_END_ADDRESS									STM32F103_FLASH_END
+#endif
+#define BL_WRITE_BUFFERS_NUMBER							2		/* ping-pong buffers */
+#define BL_WRITE_BUFFER_SIZE								PAGE_SIZE	/* max payload of one write packet */
+#define BL_WRITE_CHUNK_SIZE									8		/* bytes programmed between two rx polls */
+#define BL_WRITE_END_REPLY_LEN							6		/* write status, image status and the signature check time in us */
+
+/*******************************************************************************
+*                        		SLIDING WINDOW WRITE	 		                  	       *
+*******************************************************************************/
+/* The ring must hold a whole window of outstanding frames, the host picks a small
+ * payload so the window covers the round trip of the link (14 frames of 256 bytes) */
+#define BL_WINDOW_FRAME_OVERHEAD							16		/* v2 header, sequence number, address, length and CRC */
+#define BL_WRITE_WINDOW_MAX(Payload_Len)					(BL_HOST_RX_RING_SIZE / ((Payload_Len) + BL_WINDOW_FRAME_OVERHEAD) - 1)
+#define BL_WINDOW_START_LEN									9		/* [Len][Command][Window][Payload Length] and the CRC */
+#define BL_WINDOW_CLOSED										0x00
+#define BL_WINDOW_REPLY_LEN									3		/* sequence number and write status */
+
+/*******************************************************************************
+*                        		COMPRESSED WRITE			 		                  	       *
+*******************************************************************************/
+/* LZSS stream : a flag byte then up to 8 tokens, a set flag bit (LSB first) is a literal
+ * byte and a clear one a match [distance - 1][length - 3] copied from the last output bytes */
+#define BL_LZ_WINDOW_SIZE										256		/* power of 2, the distance is one byte */
+#define BL_LZ_MIN_MATCH											3
+#define BL_LZ_TOKENS_PER_FLAG								8
+#define BL_LZ_LITERAL_FLAG									0x01
+#define BL_LZ_REPLY_LEN											5		/* write status and the decompressed length */
+
+/*******************************************************************************
+*                        		DELTA UPDATE			 		                  	           *
+*******************************************************************************/
+/* Patch stream against the installed image at APP_BASE_ADDREESS :
+ * copy   : [0x01][Source Offset (4)][Length (2)] bytes of the installed image
+ * insert : [0x02][Length (2)][Length new bytes]
+ * Each new page is built in a write buffer, then its flash page is erased and
+ * programmed, so a copy may only read the page being built or the ones after it */
+#define BL_DELTA_OP_COPY										0x01
+#define BL_DELTA_OP_INSERT									0x02
+#define BL_DELTA_COPY_ARGS_SIZE							6
+#define BL_DELTA_INSERT_ARGS_SIZE						2
+#define BL_DELTA_SOURCE_MISMATCH						0x00
+#define BL_DELTA_SOURCE_VALID								0x01
+#define BL_DELTA_CRC_MISMATCH								0x02	/* patch applied but the new image CRC is wrong */
+#define BL_DELTA_REPLY_LEN									5		/* status and the bytes of the new image so far */
+
+/*******************************************************************************
+*                        		BATCH			 		                  	           		 *
+*******************************************************************************/
+/* Batch : [Options][Sub Length][Command][Arguments]...[Sub Length][Command][Arguments]
+ * with one CRC for the whole frame, Sub Length counts the command and its arguments.
+ * Reply : [Executed][Batch Status][ACK or NACK][Length][Payload]... one entry per executed command */
+#define BL_BATCH_STOP_ON_ERROR							0x01	/* option : stop at the first failed command */
+#define BL_BATCH_FIRST_SUB_OFFSET						3
+#define BL_BATCH_REPLY_FIRST_ENTRY					2
+
+/* Batch status */
+#define BL_BATCH_COMPLETED									0x00
+#define BL_BATCH_STOPPED_ON_ERROR						0x01	/* a command failed with the stop on error option */
+#define BL_BATCH_BAD_SUB_COMMAND						0x02	/* a sub-command length is wrong, it was not run */
+#define BL_BATCH_REPLY_OVERFLOW							0x03	/* the next reply might not fit, it was not run */
+
+/*******************************************************************************
+*                        		APPLICATION IMAGE			 		                  	       *
+*******************************************************************************/
+/* The application area ends with the image signature and the image trailer : [Magic][Image Length]
+ * [Image CRC32][Magic ^ Length ^ CRC], the CRC is v2 over the image from APP_BASE_ADDREESS and the
+ * signature is RSA-2048 PKCS#1 v1.5 of the SHA-256 of the same bytes */
+#define BL_METADATA_PAGE_ADDRESS						(STM32F103_FLASH_END - PAGE_SIZE)
+#define BL_APP_AREA_SIZE								(BL_METADATA_PAGE_ADDRESS - APP_BASE_ADDREESS)	/* application flash, trailer included */
+#define BL_APP_TRAILER_SIZE									16
+#define BL_APP_TRAILER_ADDRESS							(BL_METADATA_PAGE_ADDRESS - BL_APP_TRAILER_SIZE)
+#define BL_APP_SIGNATURE_SIZE								256		/* BL_RSA_SIZE */
+#define BL_APP_SIGNATURE_ADDRESS						(BL_APP_TRAILER_ADDRESS - BL_APP_SIGNATURE_SIZE)
+#define BL_APP_MAX_SIZE											(BL_APP_SIGNATURE_ADDRESS - APP_BASE_ADDREESS)
+#define BL_APP_TRAILER_MAGIC								0x50414C42	/* "BLAP" */
+#define BL_APP_CRC_MODE											BL_CRC_MODE_V2
+#define BL_APP_IMAGE_INVALID								0x00
+#define BL_APP_IMAGE_VALID									0x01
+
+/* Metadata page : records [Type][Image CRC32][Write Count][Type ^ CRC ^ Count] added one
+ * after the other, the page is erased when it is full. A write record goes before the first
+ * flash change of the application area and a validated record after a full image CRC, so
+ * the image is good while the last record is a validated one with the trailer CRC */
+#define BL_META_RECORD_SIZE									16
+#define BL_META_RECORDS_NUMBER							(PAGE_SIZE / BL_META_RECORD_SIZE)
+#define BL_META_RECORD_ERASED								0xFFFFFFFF
+#define BL_META_RECORD_WRITE								0x5752544D	/* "MTRW" */
+#define BL_META_RECORD_VALIDATED						0x4C41564D	/* "MVAL" */
+
+/*******************************************************************************
+*                        		PAGE MANIFEST			 		                  	       		 *
+*******************************************************************************/
+/* Pages of the application area, page 0 is at APP_BASE_ADDREESS :
+ * page CRC   : [First Page (2)][Pages Number (2)], reply one CRC32 per page in the link CRC mode
+ * page erase : [First Page (2)][Pages Number (2)], reply the erase status
+ * so the host rewrites only the pages that differ from its new image */
+#define BL_APP_PAGES_NUMBER									(BL_APP_AREA_SIZE / PAGE_SIZE)
+#define BL_PAGE_CRC_MAX_PAGES								(BL_REPLY_MAX_LEN / CRC_BYTE_SIZE)
+
+/*******************************************************************************
+*                        		IMAGE HASH			 		                  	       		 *
+*******************************************************************************/
+/* The flash programmed from APP_BASE_ADDREESS up is fed to a running v2 CRC32, as the trailer one,
+ * as it is written, the gaps the host skips are fed as they are in the flash. A write or an erase
+ * behind the fed bytes (out of order or page diff writes) stops the feeding and the end of image
+ * reads the whole image once instead.
+ * End of image : [Image Length (4)][Image CRC32 (4)], reply [Status][Running CRC32 (4)] */
+#define BL_IMAGE_HASH_MISMATCH							0x00
+#define BL_IMAGE_HASH_MATCH									0x01
+#define BL_IMAGE_HASH_INVALID								0x02	/* nothing written or the length is past the application area */
+#define BL_IMAGE_END_REPLY_LEN							5
 
 /*******************************************************************************
 *                        		FLASH PROROTECTION			 		                  	           *
@@ -118,10 +319,74 @@ typedef void(*pFunction)(void) ;
 #define ROP_CHANGE_FAILED										0x00
 #define ROP_CHANGE_SUCCESSED								0x01
 
+/*******************************************************************************
+*                        		BAUD RATE			 		                  	           *
+*******************************************************************************/
+#define BL_DEFAULT_BAUD_RATE								115200
+#define BL_BAUD_CONFIRM_BYTE								0xA5
+#define BL_BAUD_CONFIRM_TIMEOUT							500		/* ms to wait the host at the new speed */
+#define BAUD_RATE_INVALID										0x00
+#define BAUD_RATE_VALID											0x01
+
+/*******************************************************************************
+*                        		AUTO BAUD			 		                  	           *
+*******************************************************************************/
+/* 0x7F on the line : start bit, 7 high bits then a low bit 7, so the first two
+ * falling edges are 8 bit times apart and the rising edge is 1 bit time after */
+#define BL_AUTO_BAUD_SYNC_BYTE							0x7F
+#define BL_AUTO_BAUD_SYNC_BITS							8
+#define BL_AUTO_BAUD_TIMER									TIM1	/* TIM1_CH3 is on PA10 (USART1_RX) */
+#define BL_AUTO_BAUD_MIN										9600		/* 8 bit times must fit the 16 bit counter */
+#define BL_AUTO_BAUD_MAX										2250000
+
+/*******************************************************************************
+*                        		CAN TRANSPORT			 		                  	           *
+*******************************************************************************/
+/* ISO-TP (ISO 15765-2) on 11 bit identifiers, each host frame (v1, v2 or COBS) is one
+ * message and each reply frame is one message, the bytes go through the same parser
+ * single       : [0x0 | Length][up to 7 bytes]
+ * first        : [0x1 | Length bits 11-8][Length bits 7-0][6 bytes]
+ * consecutive  : [0x2 | Sequence Number][up to 7 bytes]
+ * flow control : [0x3 | Flow Status][Block Size][STmin] */
+#define BL_CAN_REQUEST_ID										0x7E0	/* host to BL */
+#define BL_CAN_RESPONSE_ID									0x7E8	/* BL to host */
+#define BL_CAN_STD_ID_MASK									0x7FF
+#define BL_CAN_FRAME_SIZE										8
+#define BL_CAN_TX_MAILBOXES									3
+#define BL_CAN_BLOCK_SIZE										3		/* the rx FIFO depth, a block waits there while the flash stalls the core */
+#define BL_CAN_ST_MIN												0		/* ms the host waits between two consecutive frames */
+#define BL_ISOTP_PCI_TYPE_MASK							0xF0
+#define BL_ISOTP_PCI_LOW_MASK								0x0F	/* single frame length, sequence number or flow status */
+#define BL_ISOTP_PCI_SINGLE									0x00
+#define BL_ISOTP_PCI_FIRST									0x10
+#define BL_ISOTP_PCI_CONSECUTIVE						0x20
+#define BL_ISOTP_PCI_FLOW_CONTROL						0x30
+#define BL_ISOTP_SF_MAX_LEN									7
+#define BL_ISOTP_FF_DATA_LEN								6
+#define BL_ISOTP_CF_DATA_LEN								7
+#define BL_ISOTP_FC_LEN											3
+#define BL_ISOTP_FC_CTS											0x00
+#define BL_ISOTP_FC_WAIT										0x01
+#define BL_ISOTP_FC_OVERFLOW								0x02
+#define BL_ISOTP_FC_NONE										0xFF	/* no flow control received yet */
+#define BL_ISOTP_ST_MIN_MAX_MS							0x7F	/* 0xF1-0xF9 are 100-900 us, the rest is reserved */
+#define BL_ISOTP_ST_MIN_US_FIRST						0xF1
+#define BL_ISOTP_ST_MIN_US_LAST							0xF9
+#define BL_ISOTP_TIMEOUT										1000	/* ms, N_Bs : wait for the host flow control */
+
 /*******************************************************************************
 *                      Functions Prototypes                                    *
 *******************************************************************************/
 
+/*******************************************************************************
+* Function Name:		BL_Init
+* Description:			Function to start the reception of the host link (BL_HOST_TRANSPORT)
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+void BL_Init(void);
+
 /*******************************************************************************
 * Function Name:		BL_UART_Fetch_Host_command
 * Description:			Function to process the data received
@@ -131,6 +396,16 @@ typedef void(*pFunction)(void) ;
 ********************************************************************************/
 BL_Status BL_UART_Fetch_Host_Command(void);
 
+/*******************************************************************************
+* Function Name:		BL_Auto_Baud_Detect
+* Description:			Function to wait the sync byte of the host, measure its bit time
+*										and set the host uart to the same baud rate, nothing to do on CAN
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+void BL_Auto_Baud_Detect(void);
+
 /*******************************************************************************
 * Function Name:		BL_Print_Message
 * Description:			Function to take string from and print it to the uart
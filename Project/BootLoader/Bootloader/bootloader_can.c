@@ -0,0 +1,503 @@
+/******************************************************************************
+*  File name:		bootloader_can.c
+*  Date:				Oct 16, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/*******************************************************************************
+*                        		Inclusions                                   		   *
+*******************************************************************************/
+#include <stdint.h>
+#include <string.h>
+#include "bootloader.h"
+#include "can.h"
+#include "bootloader_transport.h"
+
+/*******************************************************************************
+*                      Private Types                               		         *
+*******************************************************************************/
+/*******************************************************************************
+* Name: BL_CAN_Link
+* Type: Structure
+* Description: ISO-TP segmentation state of the host link on CAN
+********************************************************************************/
+typedef struct
+{
+	uint16_t Rx_Left;						/* bytes of the host message still to come */
+	uint8_t Rx_Sequence_Number;	/* expected in the next consecutive frame */
+	uint8_t Rx_Block_Left;			/* consecutive frames before the next flow control */
+	uint8_t Rx_CTS_Pending;			/* a block ended, the next clear to send waits for room in the ring */
+	uint8_t Tx_Flow_Status;			/* last flow control of the host */
+	uint8_t Tx_Block_Size;
+	uint8_t Tx_ST_Min;					/* ms between two consecutive frames */
+}BL_CAN_Link;
+
+/*******************************************************************************
+*                      Private Functions                               		     *
+*******************************************************************************/
+/*******************************************************************************
+* Function Name:		BL_CAN_Init
+* Description:			Let only the host requests in the rx FIFO and start the CAN controller
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_Init(void);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Poll
+* Description:			Move the received CAN frames to the host ring and send the next
+*										flow control when the ring has room for a block
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_Poll(void);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Available
+* Description:			Poll the CAN controller and get the bytes waiting in the ring
+* Parameters (in):  None
+* Parameters (out): Number of bytes
+* Return value:     uint16_t
+********************************************************************************/
+static uint16_t BL_CAN_Rx_Available(void);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Read
+* Description:			Copy reassembled bytes from the ring
+* Parameters (in):  data buffer and the size, no more than the available bytes
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_Rx_Read(uint8_t *Data, uint16_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Free
+* Description:			Get the room left in the host ring
+* Parameters (in):  None
+* Parameters (out): Number of bytes
+* Return value:     uint16_t
+********************************************************************************/
+static uint16_t BL_CAN_Rx_Free(void);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Store
+* Description:			Append the data of a received frame to the host ring
+* Parameters (in):  data buffer and the size
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_Rx_Store(uint8_t *Data, uint16_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Receive_Frame
+* Description:			Reassemble the host messages and take the flow control of the host
+* Parameters (in):  The frame data and its DLC
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_Receive_Frame(uint8_t *Frame, uint8_t Frame_Len);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Send_Frame
+* Description:			Put one frame in a free tx mailbox
+* Parameters (in):  The frame data and its DLC
+* Parameters (out): None
+* Return value:     HAL_OK or HAL_TIMEOUT when no mailbox gets free (bus off)
+********************************************************************************/
+static HAL_StatusTypeDef BL_CAN_Send_Frame(uint8_t *Frame, uint8_t Frame_Len);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Send
+* Description:			Send a reply as one ISO-TP message, it returns when the last frame
+*										is in a mailbox
+* Parameters (in):  data buffer and the size (4095 max)
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_Send(uint8_t *Data_Buffer, uint16_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Flush
+* Description:			Wait till the tx mailboxes are empty
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_Flush(void);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Get_Errors
+* Description:			Get the number of messages dropped by the ISO-TP layer
+* Parameters (in):  None
+* Parameters (out): Number of messages
+* Return value:     uint32_t
+********************************************************************************/
+static uint32_t BL_CAN_Get_Errors(void);
+
+/*******************************************************************************
+* Function Name:		BL_CAN_DeInit
+* Description:			Stop the CAN controller
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CAN_DeInit(void);
+
+/*******************************************************************************
+*                           Global Variables                                  *
+*******************************************************************************/
+/* The ring is filled by the ISO-TP reassembly, which moves the head */
+static uint8_t BL_CAN_Rx_Ring[BL_HOST_RX_RING_SIZE];
+static uint16_t BL_CAN_Rx_Head = 0;
+static uint16_t BL_CAN_Rx_Tail = 0;
+static BL_CAN_Link BL_CAN;
+static uint32_t BL_CAN_Errors = 0;
+
+const BL_Transport BL_CAN_Transport =
+{
+	BL_CAN_Init,
+	NULL,								/* the bit rate is set for the whole bus */
+	BL_CAN_Rx_Available,
+	BL_CAN_Rx_Read,
+	BL_CAN_Send,
+	BL_CAN_Flush,
+	NULL,
+	BL_CAN_Get_Errors,
+	BL_CAN_DeInit,
+	BL_CAN_BYTE_TIMEOUT,
+	BL_PARSER_FRAME_TIMEOUT
+};
+
+/*******************************************************************************
+*                      Private Functions Definitions                           *
+*******************************************************************************/
+/*******************************************************************************
+* Function Name:		BL_CAN_Init
+********************************************************************************/
+static void BL_CAN_Init(void)
+{
+	CAN_FilterTypeDef Filter = {0};
+	
+	BL_CAN_Rx_Head = 0;
+	BL_CAN_Rx_Tail = 0;
+	memset(&BL_CAN,0,sizeof(BL_CAN));
+	BL_CAN.Tx_Flow_Status = BL_ISOTP_FC_NONE;
+	/* Standard identifiers sit in the top 11 bits of the 32 bit filter registers */
+	Filter.FilterIdHigh = (uint32_t)(BL_CAN_REQUEST_ID << 5);
+	Filter.FilterIdLow = 0;
+	Filter.FilterMaskIdHigh = (uint32_t)(BL_CAN_STD_ID_MASK << 5);
+	Filter.FilterMaskIdLow = CAN_ID_EXT;	/* IDE bit, extended frames never match */
+	Filter.FilterFIFOAssignment = CAN_FILTER_FIFO0;
+	Filter.FilterBank = 0;
+	Filter.FilterMode = CAN_FILTERMODE_IDMASK;
+	Filter.FilterScale = CAN_FILTERSCALE_32BIT;
+	Filter.FilterActivation = ENABLE;
+	HAL_CAN_ConfigFilter(BL_HOST_COMMUNICATION_CAN,&Filter);
+	HAL_CAN_Start(BL_HOST_COMMUNICATION_CAN);
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Poll
+********************************************************************************/
+static void BL_CAN_Poll(void)
+{
+	CAN_RxHeaderTypeDef Header = {0};
+	uint8_t Frame[BL_CAN_FRAME_SIZE] = {0};
+	uint8_t Flow_Control[BL_ISOTP_FC_LEN] = {BL_ISOTP_PCI_FLOW_CONTROL | BL_ISOTP_FC_CTS,BL_CAN_BLOCK_SIZE,BL_CAN_ST_MIN};
+	
+	while(HAL_CAN_GetRxFifoFillLevel(BL_HOST_COMMUNICATION_CAN,CAN_RX_FIFO0) > 0)
+	{
+		if((HAL_OK == HAL_CAN_GetRxMessage(BL_HOST_COMMUNICATION_CAN,CAN_RX_FIFO0,&Header,Frame))
+			&& (CAN_RTR_DATA == Header.RTR))
+		{
+			BL_CAN_Receive_Frame(Frame,(uint8_t)Header.DLC);
+		}
+	}
+	/* The host sends the next block only after our clear to send, so a busy flash
+	 * never lets more frames come than the FIFO holds */
+	if((0 != BL_CAN.Rx_CTS_Pending) && (BL_CAN_Rx_Free() >= (BL_CAN_BLOCK_SIZE * BL_ISOTP_CF_DATA_LEN)))
+	{
+		BL_CAN.Rx_CTS_Pending = 0;
+		BL_CAN.Rx_Block_Left = BL_CAN_BLOCK_SIZE;
+		BL_CAN_Send_Frame(Flow_Control,BL_ISOTP_FC_LEN);
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Available
+********************************************************************************/
+static uint16_t BL_CAN_Rx_Available(void)
+{
+	/* Nothing moves the head behind our back, the frames waiting in the FIFO are taken here */
+	BL_CAN_Poll();
+	return (uint16_t)((BL_CAN_Rx_Head + BL_HOST_RX_RING_SIZE - BL_CAN_Rx_Tail) % BL_HOST_RX_RING_SIZE);
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Read
+********************************************************************************/
+static void BL_CAN_Rx_Read(uint8_t *Data, uint16_t Data_Len)
+{
+	uint16_t Counter = 0;
+	
+	for(Counter = 0 ; Counter < Data_Len ; Counter++)
+	{
+		Data[Counter] = BL_CAN_Rx_Ring[BL_CAN_Rx_Tail];
+		BL_CAN_Rx_Tail = (BL_CAN_Rx_Tail + 1) % BL_HOST_RX_RING_SIZE;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Free
+********************************************************************************/
+static uint16_t BL_CAN_Rx_Free(void)
+{
+	/* One slot stays empty so a full ring is not seen as empty */
+	return (uint16_t)((BL_CAN_Rx_Tail + BL_HOST_RX_RING_SIZE - BL_CAN_Rx_Head - 1) % BL_HOST_RX_RING_SIZE);
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Rx_Store
+********************************************************************************/
+static void BL_CAN_Rx_Store(uint8_t *Data, uint16_t Data_Len)
+{
+	uint16_t Counter = 0;
+	
+	for(Counter = 0 ; Counter < Data_Len ; Counter++)
+	{
+		BL_CAN_Rx_Ring[BL_CAN_Rx_Head] = Data[Counter];
+		BL_CAN_Rx_Head = (BL_CAN_Rx_Head + 1) % BL_HOST_RX_RING_SIZE;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Receive_Frame
+********************************************************************************/
+static void BL_CAN_Receive_Frame(uint8_t *Frame, uint8_t Frame_Len)
+{
+	uint8_t Flow_Control[BL_ISOTP_FC_LEN] = {BL_ISOTP_PCI_FLOW_CONTROL | BL_ISOTP_FC_OVERFLOW,0,0};
+	uint16_t Length = 0;
+	
+	if(0 == Frame_Len)
+	{
+		return;
+	}
+	switch(Frame[0] & BL_ISOTP_PCI_TYPE_MASK)
+	{
+		case BL_ISOTP_PCI_SINGLE:
+			Length = Frame[0] & BL_ISOTP_PCI_LOW_MASK;
+			if((0 != Length) && (Length < Frame_Len) && (Length <= BL_CAN_Rx_Free()))
+			{
+				BL_CAN_Rx_Store(Frame+1,Length);
+			}
+			else
+			{
+				BL_CAN_Errors++;
+			}
+			break;
+		
+		case BL_ISOTP_PCI_FIRST:
+			if(0 != BL_CAN.Rx_Left)
+			{
+				/* The host gave up the previous message, the parser drops its start */
+				BL_CAN_Errors++;
+				BL_CAN.Rx_Left = 0;
+				BL_CAN.Rx_CTS_Pending = 0;
+			}
+			Length = (uint16_t)(((Frame[0] & BL_ISOTP_PCI_LOW_MASK) << 8) | Frame[1]);
+			if((BL_CAN_FRAME_SIZE != Frame_Len) || (Length <= BL_ISOTP_SF_MAX_LEN))
+			{
+				BL_CAN_Errors++;
+			}
+			else if((Length >= BL_HOST_RX_RING_SIZE) || (BL_CAN_Rx_Free() < BL_ISOTP_FF_DATA_LEN))
+			{
+				/* The host aborts the message */
+				BL_CAN_Errors++;
+				BL_CAN_Send_Frame(Flow_Control,BL_ISOTP_FC_LEN);
+			}
+			else
+			{
+				BL_CAN_Rx_Store(Frame+2,BL_ISOTP_FF_DATA_LEN);
+				BL_CAN.Rx_Left = Length - BL_ISOTP_FF_DATA_LEN;
+				BL_CAN.Rx_Sequence_Number = 1;
+				BL_CAN.Rx_CTS_Pending = 1;
+			}
+			break;
+		
+		case BL_ISOTP_PCI_CONSECUTIVE:
+			if(0 == BL_CAN.Rx_Left)
+			{
+				break;
+			}
+			Length = (BL_CAN.Rx_Left < BL_ISOTP_CF_DATA_LEN) ? BL_CAN.Rx_Left : BL_ISOTP_CF_DATA_LEN;
+			if(((Frame[0] & BL_ISOTP_PCI_LOW_MASK) != BL_CAN.Rx_Sequence_Number) || (Frame_Len <= Length))
+			{
+				/* A lost frame, drop the rest of the message and let the parser time out */
+				BL_CAN_Errors++;
+				BL_CAN.Rx_Left = 0;
+				BL_CAN.Rx_CTS_Pending = 0;
+				break;
+			}
+			BL_CAN_Rx_Store(Frame+1,Length);
+			BL_CAN.Rx_Left -= Length;
+			BL_CAN.Rx_Sequence_Number = (BL_CAN.Rx_Sequence_Number + 1) & BL_ISOTP_PCI_LOW_MASK;
+			BL_CAN.Rx_Block_Left--;
+			if((0 != BL_CAN.Rx_Left) && (0 == BL_CAN.Rx_Block_Left))
+			{
+				BL_CAN.Rx_CTS_Pending = 1;
+			}
+			break;
+		
+		case BL_ISOTP_PCI_FLOW_CONTROL:
+			if(Frame_Len < BL_ISOTP_FC_LEN)
+			{
+				break;
+			}
+			BL_CAN.Tx_Flow_Status = Frame[0] & BL_ISOTP_PCI_LOW_MASK;
+			BL_CAN.Tx_Block_Size = Frame[1];
+			BL_CAN.Tx_ST_Min = Frame[2];
+			if((Frame[2] >= BL_ISOTP_ST_MIN_US_FIRST) && (Frame[2] <= BL_ISOTP_ST_MIN_US_LAST))
+			{
+				/* Less than a tick */
+				BL_CAN.Tx_ST_Min = 0;
+			}
+			else if(Frame[2] > BL_ISOTP_ST_MIN_MAX_MS)
+			{
+				/* Reserved values are read as the longest time */
+				BL_CAN.Tx_ST_Min = BL_ISOTP_ST_MIN_MAX_MS;
+			}
+			break;
+		
+		default:
+			BL_CAN_Errors++;
+			break;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Send_Frame
+********************************************************************************/
+static HAL_StatusTypeDef BL_CAN_Send_Frame(uint8_t *Frame, uint8_t Frame_Len)
+{
+	CAN_TxHeaderTypeDef Header = {0};
+	uint32_t Mailbox = 0;
+	uint32_t Start_Tick = HAL_GetTick();
+	
+	Header.StdId = BL_CAN_RESPONSE_ID;
+	Header.IDE = CAN_ID_STD;
+	Header.RTR = CAN_RTR_DATA;
+	Header.DLC = Frame_Len;
+	Header.TransmitGlobalTime = DISABLE;
+	/* The mailboxes go out in request order (TXFP), wait only when the three are busy */
+	while(0 == HAL_CAN_GetTxMailboxesFreeLevel(BL_HOST_COMMUNICATION_CAN))
+	{
+		if((HAL_GetTick() - Start_Tick) > BL_ISOTP_TIMEOUT)
+		{
+			return HAL_TIMEOUT;
+		}
+	}
+	return HAL_CAN_AddTxMessage(BL_HOST_COMMUNICATION_CAN,&Header,Frame,&Mailbox);
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Send
+********************************************************************************/
+static void BL_CAN_Send(uint8_t *Data_Buffer, uint16_t Data_Len)
+{
+	uint8_t Frame[BL_CAN_FRAME_SIZE] = {0};
+	uint16_t Sent = 0;
+	uint16_t Length = 0;
+	uint16_t Block_Left = 0;
+	uint8_t Sequence_Number = 1;
+	uint32_t Start_Tick = 0;
+	
+	if(Data_Len <= BL_ISOTP_SF_MAX_LEN)
+	{
+		Frame[0] = BL_ISOTP_PCI_SINGLE | (uint8_t)Data_Len;
+		memcpy(Frame+1,Data_Buffer,Data_Len);
+		BL_CAN_Send_Frame(Frame,(uint8_t)(Data_Len + 1));
+		return;
+	}
+	Frame[0] = BL_ISOTP_PCI_FIRST | (uint8_t)(Data_Len >> 8);
+	Frame[1] = (uint8_t)Data_Len;
+	memcpy(Frame+2,Data_Buffer,BL_ISOTP_FF_DATA_LEN);
+	BL_CAN.Tx_Flow_Status = BL_ISOTP_FC_NONE;
+	if(HAL_OK != BL_CAN_Send_Frame(Frame,BL_CAN_FRAME_SIZE))
+	{
+		return;
+	}
+	Sent = BL_ISOTP_FF_DATA_LEN;
+	
+	while(Sent < Data_Len)
+	{
+		if(0 == Block_Left)
+		{
+			/* Wait the clear to send of the host, the host requests keep being received meanwhile */
+			Start_Tick = HAL_GetTick();
+			while(BL_ISOTP_FC_CTS != BL_CAN.Tx_Flow_Status)
+			{
+				BL_CAN_Poll();
+				if(BL_ISOTP_FC_WAIT == BL_CAN.Tx_Flow_Status)
+				{
+					BL_CAN.Tx_Flow_Status = BL_ISOTP_FC_NONE;
+					Start_Tick = HAL_GetTick();
+				}
+				if((BL_ISOTP_FC_OVERFLOW == BL_CAN.Tx_Flow_Status) || ((HAL_GetTick() - Start_Tick) > BL_ISOTP_TIMEOUT))
+				{
+					/* The host drops the reply and times out */
+					BL_CAN_Errors++;
+					return;
+				}
+			}
+			BL_CAN.Tx_Flow_Status = BL_ISOTP_FC_NONE;
+			/* A block size of 0 means no more flow control for this message */
+			Block_Left = (0 == BL_CAN.Tx_Block_Size) ? Data_Len : BL_CAN.Tx_Block_Size;
+		}
+		else if(0 != BL_CAN.Tx_ST_Min)
+		{
+			Start_Tick = HAL_GetTick();
+			while((HAL_GetTick() - Start_Tick) <= BL_CAN.Tx_ST_Min);
+		}
+		Length = ((Data_Len - Sent) < BL_ISOTP_CF_DATA_LEN) ? (Data_Len - Sent) : BL_ISOTP_CF_DATA_LEN;
+		Frame[0] = BL_ISOTP_PCI_CONSECUTIVE | Sequence_Number;
+		memcpy(Frame+1,Data_Buffer+Sent,Length);
+		if(HAL_OK != BL_CAN_Send_Frame(Frame,(uint8_t)(Length + 1)))
+		{
+			return;
+		}
+		Sent += Length;
+		Sequence_Number = (Sequence_Number + 1) & BL_ISOTP_PCI_LOW_MASK;
+		Block_Left--;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Flush
+********************************************************************************/
+static void BL_CAN_Flush(void)
+{
+	uint32_t Start_Tick = HAL_GetTick();
+	/* The messages are segmented before the send returns, only the mailboxes can be pending */
+	while((BL_CAN_TX_MAILBOXES != HAL_CAN_GetTxMailboxesFreeLevel(BL_HOST_COMMUNICATION_CAN))
+		&& ((HAL_GetTick() - Start_Tick) < BL_ISOTP_TIMEOUT));
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_Get_Errors
+********************************************************************************/
+static uint32_t BL_CAN_Get_Errors(void)
+{
+	return BL_CAN_Errors;
+}
+
+/*******************************************************************************
+* Function Name:		BL_CAN_DeInit
+********************************************************************************/
+static void BL_CAN_DeInit(void)
+{
+	/* Leave the CAN controller in its reset state */
+	HAL_CAN_DeInit(BL_HOST_COMMUNICATION_CAN);
+}
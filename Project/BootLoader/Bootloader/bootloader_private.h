@@ -2,26 +2,290 @@
 #ifndef		_BL_PRIVATE_H_
 #define		_BL_PRIVATE_H_
 
+/*******************************************************************************
+*                      Private Types                               		         *
+*******************************************************************************/
+/*******************************************************************************
+* Name: BL_Write_Buffer
+* Type: Structure
+* Description: Payload waiting to be programmed while the next packet is received
+********************************************************************************/
+typedef struct
+{
+	uint8_t Payload[BL_WRITE_BUFFER_SIZE];
+	uint32_t Start_Address;
+	uint16_t Payload_Len;
+	uint16_t Programmed_Len;
+}BL_Write_Buffer;
+
+/*******************************************************************************
+* Name: BL_LZ_State
+* Type: Enumeration
+* Description: Which byte of the compressed stream the decoder waits
+********************************************************************************/
+typedef enum
+{
+	BL_LZ_FLAGS,						/* flag byte of the next 8 tokens */
+	BL_LZ_TOKEN,						/* a literal or the distance of a match */
+	BL_LZ_MATCH_LENGTH			/* the length of a match */
+}BL_LZ_State;
+
+/*******************************************************************************
+* Name: BL_LZ_Decoder
+* Type: Structure
+* Description: Compressed write stream, decoded straight into the write pipeline buffers
+********************************************************************************/
+typedef struct
+{
+	uint8_t Window[BL_LZ_WINDOW_SIZE];	/* last output bytes for the matches */
+	uint16_t Window_Index;
+	BL_LZ_State State;
+	uint8_t Flags;
+	uint8_t Flags_Left;
+	uint8_t Match_Distance;
+	uint8_t Active;
+	uint8_t Status;
+	uint32_t Start_Address;			/* image address carried by every frame of the stream */
+	uint32_t Output_Address;		/* flash address of the buffer being filled */
+	uint32_t Output_Total;			/* bytes decompressed since the stream start */
+	uint8_t *Output;						/* write pipeline buffer being filled */
+	uint16_t Output_Len;
+}BL_LZ_Decoder;
+
+/*******************************************************************************
+* Name: BL_Delta_State
+* Type: Enumeration
+* Description: Which part of a patch operation the delta decoder waits
+********************************************************************************/
+typedef enum
+{
+	BL_DELTA_OP,						/* operation code */
+	BL_DELTA_ARGS,					/* arguments of the operation */
+	BL_DELTA_INSERT_DATA		/* new bytes of an insert */
+}BL_Delta_State;
+
+/*******************************************************************************
+* Name: BL_Delta_Patch
+* Type: Structure
+* Description: Delta update session, the new pages are built in a write pipeline buffer
+********************************************************************************/
+typedef struct
+{
+	BL_Delta_State State;
+	uint8_t Op;
+	uint8_t Args[BL_DELTA_COPY_ARGS_SIZE];
+	uint8_t Args_Size;
+	uint8_t Args_Received;
+	uint8_t Active;
+	uint8_t Status;
+	uint16_t Insert_Left;
+	uint32_t New_Length;				/* announced by the start command */
+	uint32_t New_CRC;
+	uint32_t Output_Total;			/* bytes of the new image built so far */
+	uint8_t *Page;							/* scratch page holding the new page being built */
+	uint16_t Page_Len;
+}BL_Delta_Patch;
+
+/*******************************************************************************
+* Name: BL_Meta_Record
+* Type: Structure
+* Description: One record of the metadata page
+********************************************************************************/
+typedef struct
+{
+	uint32_t Type;
+	uint32_t Image_CRC;
+	uint32_t Write_Count;				/* write records since the page was erased */
+	uint32_t Check;							/* Type ^ Image_CRC ^ Write_Count */
+}BL_Meta_Record;
+
+/*******************************************************************************
+* Name: BL_Meta_State
+* Type: Structure
+* Description: Copy of the last metadata record, read once from the page
+********************************************************************************/
+typedef struct
+{
+	uint8_t Loaded;
+	uint8_t Appending;					/* the BL programs a record, no host write goes there */
+	uint16_t Next_Record;				/* first erased record of the page */
+	BL_Meta_Record Last;				/* Type is 0 if the last record is broken */
+}BL_Meta_State;
+
+/*******************************************************************************
+* Name: BL_Image_Hash_State
+* Type: Structure
+* Description: Running CRC of the application area programmed so far
+********************************************************************************/
+typedef struct
+{
+	uint8_t Active;
+	uint8_t Out_Of_Order;				/* bytes already fed changed, the end of image reads the flash */
+	uint32_t Next_Address;			/* first flash byte not fed yet */
+	uint32_t Pending;						/* bytes of the last word not full yet, LSB first */
+	uint32_t CRC_Value;					/* of the whole words fed so far */
+}BL_Image_Hash_State;
+
+/*******************************************************************************
+* Name: BL_Batch_Reply
+* Type: Structure
+* Description: Replies of the batch sub-commands collected for one reply frame
+********************************************************************************/
+typedef struct
+{
+	uint8_t Active;							/* the replies go to the batch instead of the host */
+	uint16_t Reply_Len;
+	uint8_t Reply[BL_REPLY_MAX_LEN];
+}BL_Batch_Reply;
+
+/*******************************************************************************
+* Name: BL_Batch_Command
+* Type: Structure
+* Description: Command that can run inside a batch and the longest reply it can send
+********************************************************************************/
+typedef struct
+{
+	uint8_t Command;
+	uint8_t Reply_Max_Len;			/* payload bytes, without the ACK and length header */
+}BL_Batch_Command;
+
+/*******************************************************************************
+* Name: BL_Parser_State
+* Type: Enumeration
+* Description: Where the host frame parser is inside the frame
+********************************************************************************/
+typedef enum
+{
+	BL_PARSER_IDLE,					/* waiting the first byte of a frame */
+	BL_PARSER_V2_LENGTH,		/* the two length bytes after the v2 marker */
+	BL_PARSER_BODY,					/* the bytes counted by the length field */
+	BL_PARSER_COBS_HUNT,		/* dropping bytes till a delimiter */
+	BL_PARSER_COBS_DATA			/* decoding a COBS frame till its closing delimiter */
+}BL_Parser_State;
+
+/*******************************************************************************
+* Name: BL_Frame_Status
+* Type: Enumeration
+* Description: Result of feeding the parser
+********************************************************************************/
+typedef enum
+{
+	BL_FRAME_PENDING,
+	BL_FRAME_READY,
+	BL_FRAME_DROPPED,
+	BL_FRAME_TIMEOUT
+}BL_Frame_Status;
+
+/*******************************************************************************
+* Name: BL_Host_Parser
+* Type: Structure
+* Description: State of the frame being received, the frame itself is stored in the host buffer
+********************************************************************************/
+typedef struct
+{
+	BL_Parser_State State;
+	uint16_t Received;				/* bytes stored in the host buffer */
+	uint16_t Data_Length;			/* length field of the frame */
+	uint8_t Length_Received;	/* v2 length bytes received */
+	uint8_t COBS_Code;
+	uint8_t COBS_Block_Left;
+	uint32_t Frame_Start_Tick;
+	uint32_t Last_Byte_Tick;
+}BL_Host_Parser;
+
 /*******************************************************************************
 *                      Private Functions                               		     *
 *******************************************************************************/
 /*******************************************************************************
-* Function Name:		BL_Send_Data_To_Host
-* Description:			Function to send data to the host uart
-* Parameters (in):  data buffer and the size
+* Function Name:		BL_Execute_Command
+* Description:			Run the handler of a received command
+* Parameters (in):  Buffer with the command at index 1
+* Parameters (out): NACK for an unknown command or OK
+* Return value:     BL_Status
+********************************************************************************/
+static BL_Status BL_Execute_Command(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Host_Rx_Available
+* Description:			Get the number of received bytes waiting in the host link
+* Parameters (in):  None
+* Parameters (out): Number of bytes
+* Return value:     uint16_t
+********************************************************************************/
+static uint16_t BL_Host_Rx_Available(void);
+
+/*******************************************************************************
+* Function Name:		BL_Receive_Data_From_Host
+* Description:			Function to copy data received by the host link
+* Parameters (in):  data buffer, the size and the timeout in ms (HAL_MAX_DELAY to wait forever)
+* Parameters (out): HAL_OK, HAL_ERROR or HAL_TIMEOUT
+* Return value:     HAL_StatusTypeDef
+********************************************************************************/
+static HAL_StatusTypeDef BL_Receive_Data_From_Host(uint8_t *Data_Buffer, uint16_t Data_Len, uint32_t Timeout);
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Reset
+* Description:			Start a new frame in the parser
+* Parameters (in):  The state to start from
 * Parameters (out): None
 * Return value:     Void
 ********************************************************************************/
-static void BL_Send_Data_To_Host(uint8_t *Data_Buffer, uint32_t Data_Len);
+static void BL_Parser_Reset(BL_Parser_State State);
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Feed
+* Description:			Give one received byte to the host frame parser
+* Parameters (in):  The byte
+* Parameters (out): None
+* Return value:     BL_FRAME_READY when the frame is complete in the host buffer
+********************************************************************************/
+static BL_Frame_Status BL_Parser_Feed(uint8_t Data);
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Check_Length
+* Description:			Validate the length field of the frame being received
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     BL_FRAME_PENDING or BL_FRAME_DROPPED
+********************************************************************************/
+static BL_Frame_Status BL_Parser_Check_Length(void);
+
+/*******************************************************************************
+* Function Name:		BL_Parser_COBS_Decode
+* Description:			Decode one byte of a COBS frame into the host buffer, the
+*										v2 frames are stored with the raw frames layout
+* Parameters (in):  The byte
+* Parameters (out): None
+* Return value:     BL_Frame_Status
+********************************************************************************/
+static BL_Frame_Status BL_Parser_COBS_Decode(uint8_t Data);
+
+/*******************************************************************************
+* Function Name:		BL_Parser_COBS_Put_Byte
+* Description:			Append a decoded byte to the host buffer
+* Parameters (in):  The byte
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Parser_COBS_Put_Byte(uint8_t Data);
+
+/*******************************************************************************
+* Function Name:		BL_Parser_Check_Timeout
+* Description:			Drop the started frame if the host went quiet
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     BL_FRAME_TIMEOUT or BL_FRAME_PENDING
+********************************************************************************/
+static BL_Frame_Status BL_Parser_Check_Timeout(void);
 
 /*******************************************************************************
 * Function Name:		BL_Send_ACK_NACK
-* Description:			Function to send ACK or NACK to the user
-* Parameters (in):  the reply length in case we want to send ACK
+* Description:			Send ACK or NACK with its payload as one reply frame with a single transmit
+* Parameters (in):  ACK or NACK, pointer to the reply payload and its length
 * Parameters (out): None
 * Return value:     Void
 ********************************************************************************/
-static void BL_Send_ACK_NACK(BL_Status BL_Message,uint8_t Reply_Len);
+static void BL_Send_ACK_NACK(BL_Status BL_Message, uint8_t *Reply, uint8_t Reply_Len);
 
 
 /*******************************************************************************
@@ -87,6 +351,86 @@ static uint8_t BL_Host_Jump_Address_Verify(uint32_t Jump_Address);
 ********************************************************************************/
 static void BL_Jump_To_User_App(void);
 
+#ifdef BL_ENABLE_APP_IMAGE_CHECK
+/*******************************************************************************
+* Function Name:		BL_App_Image_Check
+* Description:			Check the application against its trailer, the full CRC runs only
+*										if the last metadata record isn't a validated one with the same CRC
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     BL_APP_IMAGE_VALID or BL_APP_IMAGE_INVALID
+********************************************************************************/
+static uint8_t BL_App_Image_Check(void);
+#endif
+
+#ifdef BL_ENABLE_APP_SIGNATURE_CHECK
+/*******************************************************************************
+* Function Name:		BL_App_Signature_Check
+* Description:			Hash the image with SHA-256 and check its signature with the public key
+*										of the BL, the time it took is kept for the host
+* Parameters (in):  Image length from the trailer
+* Parameters (out): None
+* Return value:     BL_SIGNATURE_VALID or BL_SIGNATURE_INVALID
+********************************************************************************/
+static uint8_t BL_App_Signature_Check(uint32_t Image_Length);
+#endif
+
+/*******************************************************************************
+* Function Name:		BL_App_Area_Changed
+* Description:			Add a write record before the first flash change of the application
+*										area since the last validation
+* Parameters (in):  Start address and length of the flash change
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_App_Area_Changed(uint32_t Address, uint32_t Length);
+
+/*******************************************************************************
+* Function Name:		BL_Meta_Load
+* Description:			Find the last record and the first erased one of the metadata page
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Meta_Load(void);
+
+/*******************************************************************************
+* Function Name:		BL_Meta_Append
+* Description:			Program a record after the last one, erase the page first if it is full
+* Parameters (in):  Record type and the image CRC
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Meta_Append(uint32_t Type, uint32_t Image_CRC);
+
+/*******************************************************************************
+* Function Name:		BL_Image_Hash_Update
+* Description:			Feed a programmed flash range to the running image CRC, the gap since
+*										the last write is fed from the flash and a write behind it starts again
+* Parameters (in):  Start address and length of the programmed range
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Image_Hash_Update(uint32_t Address, uint32_t Length);
+
+/*******************************************************************************
+* Function Name:		BL_Image_Hash_Feed
+* Description:			Feed the flash from the next address of the running CRC to an end address
+* Parameters (in):  End address
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Image_Hash_Feed(uint32_t End_Address);
+
+/*******************************************************************************
+* Function Name:		BL_Image_Hash_Erased
+* Description:			Stop the running CRC if an erase starts before its next address
+* Parameters (in):  First erased address
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Image_Hash_Erased(uint32_t Address);
+
 /*******************************************************************************
 * Function Name:		BL_Jump_To_Address
 * Description:			Jump bootloader to specified address
@@ -105,6 +449,15 @@ static void BL_Jump_To_Address(uint8_t *Hostbuffer);
 ********************************************************************************/
 static uint8_t BL_Perform_Flash_Erase(uint8_t Sector_Number, uint8_t Number_Of_Sectors);
 
+/*******************************************************************************
+* Function Name:		BL_Perform_Page_Erase
+* Description:			Erase one flash page
+* Parameters (in):  Address of the page
+* Parameters (out): Erase status
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_Perform_Page_Erase(uint32_t Page_Address);
+
 /*******************************************************************************
 * Function Name:		BL_Erase_Flash
 * Description:			Mass erase or sector erase of user flash
@@ -121,7 +474,91 @@ static void BL_Erase_Flash(uint8_t *Hostbuffer);
 * Parameters (out): OK or ERROR
 * Return value:     uint8_t
 ********************************************************************************/
-static uint8_t BL_Write_Payload_In_Flash(uint8_t *Host_Payload, uint32_t Start_Address, uint8_t Payload_Len);
+static uint8_t BL_Write_Payload_In_Flash(uint8_t *Host_Payload, uint32_t Start_Address, uint16_t Payload_Len);
+
+/*******************************************************************************
+* Function Name:		BL_Flash_Program
+* Description:			Program the payload only, the caller keeps the metadata and the image CRC
+*										(the write pipeline does it once per buffer, not per chunk)
+* Parameters (in):  The required payload, the start address and the payload length
+* Parameters (out): OK or ERROR
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_Flash_Program(uint8_t *Host_Payload, uint32_t Start_Address, uint16_t Payload_Len);
+
+/*******************************************************************************
+* Function Name:		BL_Get_Write_Payload
+* Description:			Locate the payload of a write packet (8 bit length in v1 frames,
+*										16 bit in v2 frames) and check that it fits the packet
+* Parameters (in):  The host buffer and the offset of the payload length
+* Parameters (out): The payload length, the payload or NULL if it is invalid
+* Return value:     uint8_t *
+********************************************************************************/
+static uint8_t *BL_Get_Write_Payload(uint8_t *Hostbuffer, uint16_t Length_Offset, uint16_t *Payload_Len);
+
+/*******************************************************************************
+* Function Name:		BL_Fill_Flash
+* Description:			Program a range of the flash with a repeated 16 or 32 bit pattern
+* Parameters (in):  Start address, length in bytes, the pattern and its size in bytes
+* Parameters (out): Write status
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_Fill_Flash(uint32_t Start_Address, uint32_t Length, uint32_t Pattern, uint8_t Pattern_Size);
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Fill
+* Description:			Fill a flash range with a pattern sent by the host
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Memory_Fill(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Service
+* Description:			Program the next chunk of the oldest pending write buffer
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Write_Pipeline_Service(void);
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Flush
+* Description:			Program all the pending write buffers
+* Parameters (in):  None
+* Parameters (out): OK or ERROR of all the writes since the last report
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_Write_Pipeline_Flush(void);
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Get_Buffer
+* Description:			Wait a free write buffer and give it to be filled
+* Parameters (in):  None
+* Parameters (out): Pointer to the payload of the free buffer
+* Return value:     uint8_t *
+********************************************************************************/
+static uint8_t *BL_Write_Pipeline_Get_Buffer(void);
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Commit
+* Description:			Hand the filled buffer to the programming side
+* Parameters (in):  Flash address and the length of the filled payload
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Write_Pipeline_Commit(uint32_t Start_Address, uint16_t Payload_Len);
+
+/*******************************************************************************
+* Function Name:		BL_Write_Pipeline_Queue
+* Description:			Copy the payload to a free write buffer to be programmed
+*										while the next packet is received
+* Parameters (in):  The required payload, the start address and the payload length
+* Parameters (out): OK or ERROR of the previous writes
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_Write_Pipeline_Queue(uint8_t *Host_Payload, uint32_t Start_Address, uint16_t Payload_Len);
 
 /*******************************************************************************
 * Function Name:		BL_Memory_Write
@@ -132,6 +569,261 @@ static uint8_t BL_Write_Payload_In_Flash(uint8_t *Host_Payload, uint32_t Start_A
 ********************************************************************************/
 static void BL_Memory_Write(uint8_t *Hostbuffer);
 
+/*******************************************************************************
+* Function Name:		BL_Window_Send_Reply
+* Description:			Send a cumulative ACK or a NACK with the sequence number to the host
+* Parameters (in):  ACK or NACK, the sequence number and the write status
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Window_Send_Reply(BL_Status BL_Message, uint16_t Sequence_Number, uint8_t Write_Status);
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Write_Window_Start
+* Description:			Negotiate the window size and open a sliding window write session
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Memory_Write_Window_Start(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Window_Report_Missing
+* Description:			NACK the first missing frame of the window, only once till it comes
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Window_Report_Missing(void);
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Write_Sequenced
+* Description:			Write a numbered frame of a sliding window write session
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Memory_Write_Sequenced(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Start
+* Description:			Start a new compressed stream at the given flash address
+* Parameters (in):  Flash address of the image
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_LZ_Start(uint32_t Start_Address);
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Feed
+* Description:			Decode one byte of the compressed stream
+* Parameters (in):  Compressed byte
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_LZ_Feed(uint8_t Data);
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Put_Byte
+* Description:			Store a decompressed byte in the window and the write buffer
+* Parameters (in):  Decompressed byte
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_LZ_Put_Byte(uint8_t Data);
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Commit_Output
+* Description:			Queue the filled write buffer for programming
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_LZ_Commit_Output(void);
+
+/*******************************************************************************
+* Function Name:		BL_LZ_Finish
+* Description:			End the stream and wait till all its bytes are programmed
+* Parameters (in):  None
+* Parameters (out): Write status of the whole stream
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_LZ_Finish(void);
+
+/*******************************************************************************
+* Function Name:		BL_Memory_Write_Compressed
+* Description:			Decompress the payload of a compressed write frame into the flash
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Memory_Write_Compressed(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Start
+* Description:			Check the installed image against the patch source and open a delta session
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Delta_Start(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Feed
+* Description:			Decode one byte of the patch stream
+* Parameters (in):  Patch byte
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Delta_Feed(uint8_t Data);
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Put_Byte
+* Description:			Store a byte of the new image in the scratch page
+* Parameters (in):  New image byte
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Delta_Put_Byte(uint8_t Data);
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Commit_Page
+* Description:			Erase the flash page of the scratch page and queue it for programming
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Delta_Commit_Page(void);
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Finish
+* Description:			Program the last page and check the CRC of the whole new image
+* Parameters (in):  None
+* Parameters (out): Write status or CRC mismatch
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_Delta_Finish(void);
+
+/*******************************************************************************
+* Function Name:		BL_Delta_Data
+* Description:			Apply the patch bytes of a delta frame, an empty frame ends the session
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Delta_Data(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Execute
+* Description:			Run the sub-commands of a batch in order and send all their replies in one frame
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Batch_Execute(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Capture
+* Description:			Append the reply of a sub-command to the batch reply
+* Parameters (in):  ACK or NACK, pointer to the reply payload and its length
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Batch_Capture(BL_Status BL_Message, uint8_t *Reply, uint8_t Reply_Len);
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Command_Failed
+* Description:			Check the reply of a sub-command for a NACK or a failure status
+* Parameters (in):  Command code and its entry in the batch reply
+* Parameters (out): 1 if the command failed
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_Batch_Command_Failed(uint8_t Command, uint8_t *Entry);
+
+/*******************************************************************************
+* Function Name:		BL_Batch_Send_Reply
+* Description:			Send the collected replies if a batch is running
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Batch_Send_Reply(void);
+
+/*******************************************************************************
+* Function Name:		BL_Change_Baud_Rate
+* Description:			Move the host link to a faster baud rate after a handshake
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Change_Baud_Rate(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Get_Link_Stats
+* Description:			Reply with the number of frames dropped to resync the host link
+*										and the number of frames that timed out
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Get_Link_Stats(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Set_CRC_Mode
+* Description:			Switch the CRC of the frames and the replies between v1 (byte per
+*										word) and v2 (word per word), the new mode starts after the reply
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Set_CRC_Mode(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Region_CRC
+* Description:			Reply with the CRC32 of a flash range so the host can verify an image
+*										without reading it back, one byte ADDRESS_IS_INVALID for a bad range
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Region_CRC(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Page_Range_Verify
+* Description:			Check a page range is inside the application area
+* Parameters (in):  First page and number of pages
+* Parameters (out): None
+* Return value:     ADDRESS_IS_VALID or ADDRESS_IS_INVALID
+********************************************************************************/
+static uint8_t BL_Page_Range_Verify(uint16_t First_Page, uint16_t Pages_Number);
+
+/*******************************************************************************
+* Function Name:		BL_Page_CRC
+* Description:			Reply with the CRC32 of every page of a range of the application area
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Page_CRC(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Page_Erase
+* Description:			Erase a range of pages of the application area
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Page_Erase(uint8_t *Hostbuffer);
+
+/*******************************************************************************
+* Function Name:		BL_Image_End
+* Description:			Finish the running CRC of the written image and compare it with the host one
+* Parameters (in):  The host buffer
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_Image_End(uint8_t *Hostbuffer);
+
 /*******************************************************************************
 * Function Name:		BL_Enable_RW_Protection
 * Description:			Enable read/write protect on different sectors of the user flash
@@ -186,6 +878,35 @@ static uint8_t BL_Change_ROP_Level(uint8_t ROP_Level);
 ********************************************************************************/
 static void BL_Change_Read_Protection_Level(uint8_t *Hostbuffer);
 
+/*******************************************************************************
+* Function Name:		BL_CRC_Calculate
+* Description:			Calculate the CRC32 of a buffer using the CRC engine in the current mode
+* Parameters (in):  Pointer to the data and its length
+* Parameters (out): CRC32 value
+* Return value:     uint32_t
+********************************************************************************/
+static uint32_t BL_CRC_Calculate(uint8_t *pData, uint32_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_CRC_Calculate_Region
+* Description:			Calculate the CRC32 of a flash region with the DMA feeding the CRC
+*										engine, same result as BL_CRC_Calculate in both CRC modes
+* Parameters (in):  Start address and length of the region
+* Parameters (out): CRC32 value
+* Return value:     uint32_t
+********************************************************************************/
+static uint32_t BL_CRC_Calculate_Region(uint32_t Address, uint32_t Length);
+
+/*******************************************************************************
+* Function Name:		BL_CRC_Seed
+* Description:			Load a CRC value in the reset CRC engine, the F1 engine has no init
+*										register so the word that takes the reset value to this CRC is written
+* Parameters (in):  CRC value to go on from
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_CRC_Seed(uint32_t CRC_Value);
+
 /*******************************************************************************
 * Function Name:		BL_CRC_Verify
 * Description:			Function to verify the CRC value
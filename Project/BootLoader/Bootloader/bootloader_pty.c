@@ -0,0 +1,235 @@
+/******************************************************************************
+*  File name:		bootloader_pty.c
+*  Date:				Oct 16, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* Host link for the native Linux builds of the command core : the bootloader opens a
+ * pseudo-terminal and prints its slave name, the host script opens that name as its
+ * serial port, so the commands can be run and benchmarked without the board */
+#ifdef __linux__
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+/*******************************************************************************
+*                        		Inclusions                                   		   *
+*******************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "bootloader.h"
+#include "bootloader_transport.h"
+
+/*******************************************************************************
+*                      Private Functions                               		     *
+*******************************************************************************/
+/*******************************************************************************
+* Function Name:		BL_PTY_Init
+* Description:			Open the pseudo-terminal if it is not open yet
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_PTY_Init(void);
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Sync
+* Description:			Wait the sync byte of the host so the host script runs as on the uart
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     0, a pseudo-terminal has no speed
+********************************************************************************/
+static uint32_t BL_PTY_Sync(void);
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Rx_Available
+* Description:			Get the number of bytes the host wrote and we didn't read yet
+* Parameters (in):  None
+* Parameters (out): Number of bytes
+* Return value:     uint16_t
+********************************************************************************/
+static uint16_t BL_PTY_Rx_Available(void);
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Rx_Read
+* Description:			Read bytes from the pseudo-terminal
+* Parameters (in):  data buffer and the size, no more than the available bytes
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_PTY_Rx_Read(uint8_t *Data, uint16_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Send
+* Description:			Write a reply frame to the pseudo-terminal
+* Parameters (in):  data buffer and the size
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_PTY_Send(uint8_t *Data, uint16_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Flush
+* Description:			Nothing to wait, the writes go straight to the host side
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_PTY_Flush(void);
+
+/*******************************************************************************
+* Function Name:		BL_PTY_DeInit
+* Description:			Close the pseudo-terminal
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_PTY_DeInit(void);
+
+/*******************************************************************************
+*                           Global Variables                                  *
+*******************************************************************************/
+static int BL_PTY_Master = -1;
+/* Kept open so the master reads don't fail while no host has the slave open */
+static int BL_PTY_Slave = -1;
+
+const BL_Transport BL_PTY_Transport =
+{
+	BL_PTY_Init,
+	BL_PTY_Sync,
+	BL_PTY_Rx_Available,
+	BL_PTY_Rx_Read,
+	BL_PTY_Send,
+	BL_PTY_Flush,
+	NULL,
+	NULL,
+	BL_PTY_DeInit,
+	BL_PTY_BYTE_TIMEOUT,
+	BL_PARSER_FRAME_TIMEOUT
+};
+
+/*******************************************************************************
+*                      Private Functions Definitions                           *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Init
+********************************************************************************/
+static void BL_PTY_Init(void)
+{
+	struct termios Settings;
+	
+	if(BL_PTY_Master >= 0)
+	{
+		return;
+	}
+	BL_PTY_Master = posix_openpt(O_RDWR | O_NOCTTY);
+	if((BL_PTY_Master < 0) || (0 != grantpt(BL_PTY_Master)) || (0 != unlockpt(BL_PTY_Master)))
+	{
+		perror("BL pseudo-terminal");
+		exit(EXIT_FAILURE);
+	}
+	BL_PTY_Slave = open(ptsname(BL_PTY_Master),O_RDWR | O_NOCTTY);
+	/* Raw bytes both ways, no echo and no line editing between the host and the parser */
+	tcgetattr(BL_PTY_Slave,&Settings);
+	cfmakeraw(&Settings);
+	tcsetattr(BL_PTY_Slave,TCSANOW,&Settings);
+	printf("BL host link on %s\n",ptsname(BL_PTY_Master));
+	fflush(stdout);
+}
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Sync
+********************************************************************************/
+static uint32_t BL_PTY_Sync(void)
+{
+	uint8_t Data = 0;
+	
+	BL_PTY_Init();
+	while(BL_AUTO_BAUD_SYNC_BYTE != Data)
+	{
+		if(1 != read(BL_PTY_Master,&Data,1))
+		{
+			Data = 0;
+		}
+	}
+	return 0;
+}
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Rx_Available
+********************************************************************************/
+static uint16_t BL_PTY_Rx_Available(void)
+{
+	int Count = 0;
+	
+	if(0 != ioctl(BL_PTY_Master,FIONREAD,&Count))
+	{
+		return 0;
+	}
+	return (Count > 0xFFFF) ? 0xFFFF : (uint16_t)Count;
+}
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Rx_Read
+********************************************************************************/
+static void BL_PTY_Rx_Read(uint8_t *Data, uint16_t Data_Len)
+{
+	ssize_t Received = 0;
+	
+	while(Data_Len > 0)
+	{
+		Received = read(BL_PTY_Master,Data,Data_Len);
+		if(Received <= 0)
+		{
+			break;
+		}
+		Data += Received;
+		Data_Len -= (uint16_t)Received;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Send
+********************************************************************************/
+static void BL_PTY_Send(uint8_t *Data, uint16_t Data_Len)
+{
+	ssize_t Sent = 0;
+	
+	while(Data_Len > 0)
+	{
+		Sent = write(BL_PTY_Master,Data,Data_Len);
+		if(Sent <= 0)
+		{
+			break;
+		}
+		Data += Sent;
+		Data_Len -= (uint16_t)Sent;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_PTY_Flush
+********************************************************************************/
+static void BL_PTY_Flush(void)
+{
+}
+
+/*******************************************************************************
+* Function Name:		BL_PTY_DeInit
+********************************************************************************/
+static void BL_PTY_DeInit(void)
+{
+	close(BL_PTY_Slave);
+	close(BL_PTY_Master);
+	BL_PTY_Slave = -1;
+	BL_PTY_Master = -1;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,216 @@
+/******************************************************************************
+*  File name:		bootloader_rsa.c
+*  Date:				Oct 16, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* RSA-2048 signature check with the public exponent 65537 : 16 Montgomery squarings and one
+ * multiplication, the Montgomery constants come with the key so there is no division here.
+ * Only public data goes through it, so nothing has to run in constant time */
+
+/*******************************************************************************
+*                        		Inclusions                                   		   *
+*******************************************************************************/
+#include <stdint.h>
+#include "bootloader_signature.h"
+
+/*******************************************************************************
+*                        		Definitions                                   		 *
+*******************************************************************************/
+/* EM = [0x00][0x01][0xFF ... 0xFF][0x00][SHA-256 DigestInfo][Digest] */
+#define BL_RSA_DIGEST_INFO_SIZE							19
+#define BL_RSA_DIGEST_OFFSET								(BL_RSA_SIZE - BL_SHA256_DIGEST_SIZE)
+#define BL_RSA_DIGEST_INFO_OFFSET						(BL_RSA_DIGEST_OFFSET - BL_RSA_DIGEST_INFO_SIZE)
+#define BL_RSA_PAD_END_OFFSET								(BL_RSA_DIGEST_INFO_OFFSET - 1)
+#define BL_RSA_BLOCK_TYPE										0x01
+#define BL_RSA_PAD_BYTE											0xFF
+
+/*******************************************************************************
+*                      Private Functions                               		     *
+*******************************************************************************/
+/*******************************************************************************
+* Function Name:		BL_RSA_Mont_Mul
+* Description:			Montgomery product A * B / R mod N (CIOS), A and B below N
+* Parameters (in):  Public key, A and B
+* Parameters (out): Result, may be A or B
+* Return value:     Void
+********************************************************************************/
+static void BL_RSA_Mont_Mul(const BL_RSA_Public_Key *Key, uint32_t *Result, const uint32_t *A, const uint32_t *B);
+
+/*******************************************************************************
+* Function Name:		BL_RSA_EM_Byte
+* Description:			Byte of the big endian message from its little endian words
+* Parameters (in):  Message words and the byte index (0 is the most significant)
+* Parameters (out): None
+* Return value:     uint8_t
+********************************************************************************/
+static uint8_t BL_RSA_EM_Byte(const uint32_t *Message, uint16_t Index);
+
+/*******************************************************************************
+*                           Global Variables                                  *
+*******************************************************************************/
+static const uint8_t BL_RSA_SHA256_Digest_Info[BL_RSA_DIGEST_INFO_SIZE] =
+{
+	0x30, 0x31, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+	0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20
+};
+
+/* Kept off the 1 KB stack */
+static uint32_t BL_RSA_Signature[BL_RSA_WORDS];
+static uint32_t BL_RSA_Power[BL_RSA_WORDS];
+static uint32_t BL_RSA_Product[BL_RSA_WORDS + 2];
+
+/*******************************************************************************
+*                      Functions Definitions                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		BL_RSA_Verify
+********************************************************************************/
+uint8_t BL_RSA_Verify(const BL_RSA_Public_Key *Key, const uint8_t *Signature, const uint8_t *Digest)
+{
+	uint16_t Index = 0;
+	uint8_t Expected = 0;
+
+	/* Big endian bytes to little endian words */
+	for(Index = 0 ; Index < BL_RSA_WORDS ; Index++)
+	{
+		const uint8_t *Word = Signature + BL_RSA_SIZE - (4 * (Index + 1));
+		BL_RSA_Signature[Index] = ((uint32_t)Word[0] << 24) | ((uint32_t)Word[1] << 16) | ((uint32_t)Word[2] << 8) | Word[3];
+	}
+	/* The signature must be below the modulus */
+	for(Index = BL_RSA_WORDS ; Index > 0 ; Index--)
+	{
+		if(BL_RSA_Signature[Index - 1] != Key->N[Index - 1])
+		{
+			break;
+		}
+	}
+	if((0 == Index) || (BL_RSA_Signature[Index - 1] > Key->N[Index - 1]))
+	{
+		return BL_SIGNATURE_INVALID;
+	}
+	/* S * R, then (S * R)^(2^16) / R^(2^16 - 1) = S^(2^16) * R, then * S / R = S^65537 */
+	BL_RSA_Mont_Mul(Key,BL_RSA_Power,BL_RSA_Signature,Key->RR);
+	for(Index = 0 ; Index < BL_RSA_EXPONENT_SQUARINGS ; Index++)
+	{
+		BL_RSA_Mont_Mul(Key,BL_RSA_Power,BL_RSA_Power,BL_RSA_Power);
+	}
+	BL_RSA_Mont_Mul(Key,BL_RSA_Power,BL_RSA_Power,BL_RSA_Signature);
+	/* Compare with the encoded message we expect */
+	for(Index = 0 ; Index < BL_RSA_SIZE ; Index++)
+	{
+		if(0 == Index)
+		{
+			Expected = 0x00;
+		}
+		else if(1 == Index)
+		{
+			Expected = BL_RSA_BLOCK_TYPE;
+		}
+		else if(Index < BL_RSA_PAD_END_OFFSET)
+		{
+			Expected = BL_RSA_PAD_BYTE;
+		}
+		else if(Index == BL_RSA_PAD_END_OFFSET)
+		{
+			Expected = 0x00;
+		}
+		else if(Index < BL_RSA_DIGEST_OFFSET)
+		{
+			Expected = BL_RSA_SHA256_Digest_Info[Index - BL_RSA_DIGEST_INFO_OFFSET];
+		}
+		else
+		{
+			Expected = Digest[Index - BL_RSA_DIGEST_OFFSET];
+		}
+		if(Expected != BL_RSA_EM_Byte(BL_RSA_Power,Index))
+		{
+			return BL_SIGNATURE_INVALID;
+		}
+	}
+	return BL_SIGNATURE_VALID;
+}
+
+/*******************************************************************************
+*                      Private Functions Definitions                           *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		BL_RSA_Mont_Mul
+********************************************************************************/
+static void BL_RSA_Mont_Mul(const BL_RSA_Public_Key *Key, uint32_t *Result, const uint32_t *A, const uint32_t *B)
+{
+	uint32_t *T = BL_RSA_Product;
+	uint64_t Product = 0;
+	uint32_t Carry = 0;
+	uint32_t M = 0;
+	uint32_t Borrow = 0;
+	uint8_t i = 0, j = 0;
+
+	for(j = 0 ; j < (BL_RSA_WORDS + 2) ; j++)
+	{
+		T[j] = 0;
+	}
+	for(i = 0 ; i < BL_RSA_WORDS ; i++)
+	{
+		/* T += A * B[i], one UMLAL per word */
+		Carry = 0;
+		for(j = 0 ; j < BL_RSA_WORDS ; j++)
+		{
+			Product = ((uint64_t)A[j] * B[i]) + T[j] + Carry;
+			T[j] = (uint32_t)Product;
+			Carry = (uint32_t)(Product >> 32);
+		}
+		Product = (uint64_t)T[BL_RSA_WORDS] + Carry;
+		T[BL_RSA_WORDS] = (uint32_t)Product;
+		T[BL_RSA_WORDS + 1] = (uint32_t)(Product >> 32);
+		/* T = (T + M * N) / 2^32, M makes the low word zero */
+		M = T[0] * Key->N0_Inv;
+		Product = ((uint64_t)M * Key->N[0]) + T[0];
+		Carry = (uint32_t)(Product >> 32);
+		for(j = 1 ; j < BL_RSA_WORDS ; j++)
+		{
+			Product = ((uint64_t)M * Key->N[j]) + T[j] + Carry;
+			T[j - 1] = (uint32_t)Product;
+			Carry = (uint32_t)(Product >> 32);
+		}
+		Product = (uint64_t)T[BL_RSA_WORDS] + Carry;
+		T[BL_RSA_WORDS - 1] = (uint32_t)Product;
+		T[BL_RSA_WORDS] = T[BL_RSA_WORDS + 1] + (uint32_t)(Product >> 32);
+	}
+	/* T is below 2N, take N away once if it is not below N */
+	for(j = BL_RSA_WORDS ; (0 == T[BL_RSA_WORDS]) && (j > 0) ; j--)
+	{
+		if(T[j - 1] != Key->N[j - 1])
+		{
+			break;
+		}
+	}
+	if((0 != T[BL_RSA_WORDS]) || (0 == j) || (T[j - 1] > Key->N[j - 1]))
+	{
+		for(j = 0 ; j < BL_RSA_WORDS ; j++)
+		{
+			Product = (uint64_t)T[j] - Key->N[j] - Borrow;
+			Result[j] = (uint32_t)Product;
+			Borrow = (uint32_t)(Product >> 63);
+		}
+	}
+	else
+	{
+		for(j = 0 ; j < BL_RSA_WORDS ; j++)
+		{
+			Result[j] = T[j];
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_RSA_EM_Byte
+********************************************************************************/
+static uint8_t BL_RSA_EM_Byte(const uint32_t *Message, uint16_t Index)
+{
+	uint16_t Byte_Number = BL_RSA_SIZE - 1 - Index;
+	return (uint8_t)(Message[Byte_Number / 4] >> (8 * (Byte_Number % 4)));
+}
@@ -0,0 +1,103 @@
+/******************************************************************************
+*  File name:		bootloader_signature.h
+*  Date:				Oct 16, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+#ifndef	_BOOTLOADER_SIGNATURE_H_
+#define _BOOTLOADER_SIGNATURE_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+*                        		SHA-256			 		                  	           		 *
+*******************************************************************************/
+#define BL_SHA256_BLOCK_SIZE								64
+#define BL_SHA256_DIGEST_SIZE								32
+#define BL_SHA256_STATE_WORDS								8
+
+/*******************************************************************************
+*                        		RSA			 		                  	           		 		 *
+*******************************************************************************/
+/* RSA-2048, public exponent 65537, PKCS#1 v1.5 signature of the SHA-256 digest */
+#define BL_RSA_WORDS												64
+#define BL_RSA_SIZE													(BL_RSA_WORDS * 4)
+#define BL_RSA_EXPONENT_SQUARINGS						16		/* 65537 = 2^16 + 1 */
+#define BL_SIGNATURE_INVALID								0x00
+#define BL_SIGNATURE_VALID									0x01
+
+/*******************************************************************************
+*                         Types Declaration                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* Name: BL_SHA256_Context
+* Type: Structure
+* Description: Hash of the data fed so far and the block not full yet
+********************************************************************************/
+typedef struct
+{
+	uint32_t State[BL_SHA256_STATE_WORDS];
+	uint32_t Total_Len;												/* bytes fed, an image is far below 512 MB */
+	uint8_t Block[BL_SHA256_BLOCK_SIZE];
+}BL_SHA256_Context;
+
+/*******************************************************************************
+* Name: BL_RSA_Public_Key
+* Type: Structure
+* Description: Modulus and the Montgomery constants worked out by the host when it
+*							 exports the key (python Host.py --export-key), words are little endian
+********************************************************************************/
+typedef struct
+{
+	uint32_t N0_Inv;													/* -1 / N[0] mod 2^32 */
+	uint32_t N[BL_RSA_WORDS];									/* modulus */
+	uint32_t RR[BL_RSA_WORDS];								/* 2^4096 mod N, R = 2^2048 */
+}BL_RSA_Public_Key;
+
+/*******************************************************************************
+*                      Public Key                                              *
+*******************************************************************************/
+extern const BL_RSA_Public_Key BL_App_Public_Key;		/* bootloader_key.c */
+
+/*******************************************************************************
+*                      Functions Prototypes                                    *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		BL_SHA256_Init
+* Description:			Start a new hash
+* Parameters (in):  Hash context
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+void BL_SHA256_Init(BL_SHA256_Context *Context);
+
+/*******************************************************************************
+* Function Name:		BL_SHA256_Update
+* Description:			Feed data to the hash, whole blocks are hashed straight from the data
+* Parameters (in):  Hash context, data buffer and the size
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+void BL_SHA256_Update(BL_SHA256_Context *Context, const uint8_t *Data, uint32_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_SHA256_Final
+* Description:			Pad the last block and give the digest
+* Parameters (in):  Hash context
+* Parameters (out): Digest (BL_SHA256_DIGEST_SIZE bytes)
+* Return value:     Void
+********************************************************************************/
+void BL_SHA256_Final(BL_SHA256_Context *Context, uint8_t *Digest);
+
+/*******************************************************************************
+* Function Name:		BL_RSA_Verify
+* Description:			Check a PKCS#1 v1.5 signature of a SHA-256 digest
+* Parameters (in):  Public key, signature (BL_RSA_SIZE bytes, big endian) and the digest
+* Parameters (out): None
+* Return value:     BL_SIGNATURE_VALID or BL_SIGNATURE_INVALID
+********************************************************************************/
+uint8_t BL_RSA_Verify(const BL_RSA_Public_Key *Key, const uint8_t *Signature, const uint8_t *Digest);
+
+#endif /* _BOOTLOADER_SIGNATURE_H_ */
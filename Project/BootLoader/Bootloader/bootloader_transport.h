@@ -0,0 +1,45 @@
+/******************************************************************************
+*  File name:		bootloader_transport.h
+*  Date:				Oct 16, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+#ifndef	_BOOTLOADER_TRANSPORT_H_
+#define _BOOTLOADER_TRANSPORT_H_
+
+#include <stdint.h>
+
+/*******************************************************************************
+*                         Types Declaration                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* Name: BL_Transport
+* Type: Structure
+* Description: Host link used by the command core, the link keeps the received bytes
+*							 till the parser reads them and sends each reply frame as a whole.
+*							 Sync and Set_Speed are NULL when the link has no speed to set.
+********************************************************************************/
+typedef struct
+{
+	void (*Init)(void);																/* start the reception */
+	uint32_t (*Sync)(void);														/* wait the host sync byte, returns the speed found */
+	uint16_t (*Rx_Available)(void);										/* poll the link, bytes waiting to be read */
+	void (*Rx_Read)(uint8_t *Data, uint16_t Data_Len);	/* take bytes that are available */
+	void (*Send)(uint8_t *Data, uint16_t Data_Len);		/* one reply frame, may return before it is out */
+	void (*Flush)(void);															/* wait till the sent frames are out */
+	void (*Set_Speed)(uint32_t Speed);								/* the unread bytes are dropped */
+	uint32_t (*Get_Errors)(void);											/* frames or ring overruns dropped by the link itself */
+	void (*DeInit)(void);															/* before jumping to the application */
+	uint16_t Byte_Timeout;														/* ms between two bytes of a frame */
+	uint16_t Frame_Timeout;														/* ms for a whole frame */
+}BL_Transport;
+
+/*******************************************************************************
+*                      Transports                                              *
+*******************************************************************************/
+extern const BL_Transport BL_UART_Transport;		/* USART1 with the rx and tx DMA */
+extern const BL_Transport BL_CAN_Transport;			/* bxCAN with ISO-TP segmentation */
+extern const BL_Transport BL_PTY_Transport;			/* Linux pseudo-terminal, native builds */
+
+#endif /* _BOOTLOADER_TRANSPORT_H_ */
@@ -0,0 +1,442 @@
+/******************************************************************************
+*  File name:		bootloader_uart.c
+*  Date:				Oct 16, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/*******************************************************************************
+*                        		Inclusions                                   		   *
+*******************************************************************************/
+#include <stdint.h>
+#include "bootloader.h"
+#include "usart.h"
+#include "bootloader_transport.h"
+
+/*******************************************************************************
+*                      Private Functions                               		     *
+*******************************************************************************/
+/*******************************************************************************
+* Function Name:		BL_UART_Init
+* Description:			Start the circular DMA reception of the host uart
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_UART_Init(void);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Sync
+* Description:			Wait the sync byte of the host, measure its bit time and set
+*										the host uart to the same baud rate
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     The baud rate found
+********************************************************************************/
+static uint32_t BL_UART_Sync(void);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Auto_Baud_Measure
+* Description:			Measure one byte on the rx pin and check it is the sync byte
+* Parameters (in):  None
+* Parameters (out): The baud rate
+* Return value:     HAL_OK or HAL_ERROR if it was noise or another byte
+********************************************************************************/
+static HAL_StatusTypeDef BL_UART_Auto_Baud_Measure(uint32_t *Baud_Rate);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Rx_Available
+* Description:			Get the number of received bytes waiting in the ring
+* Parameters (in):  None
+* Parameters (out): Number of bytes
+* Return value:     uint16_t
+********************************************************************************/
+static uint16_t BL_UART_Rx_Available(void);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Rx_Read
+* Description:			Copy bytes received by the DMA from the ring
+* Parameters (in):  data buffer and the size, no more than the available bytes
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_UART_Rx_Read(uint8_t *Data, uint16_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Send
+* Description:			Queue data for the host uart, it returns while the DMA sends it
+* Parameters (in):  data buffer and the size
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_UART_Send(uint8_t *Data, uint16_t Data_Len);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Tx_Start
+* Description:			Give the next queued bytes to the tx DMA if it is idle, safe from
+*										the handlers and from the tx complete interrupt
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_UART_Tx_Start(void);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Flush
+* Description:			Wait till all the queued bytes are sent
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_UART_Flush(void);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Set_Speed
+* Description:			Move the host uart to another baud rate with an empty ring
+* Parameters (in):  The baud rate
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_UART_Set_Speed(uint32_t Speed);
+
+/*******************************************************************************
+* Function Name:		BL_UART_Get_Errors
+* Description:			Get the number of times the ring was overrun and dropped
+* Parameters (in):  None
+* Parameters (out): Number of overruns
+* Return value:     uint32_t
+********************************************************************************/
+static uint32_t BL_UART_Get_Errors(void);
+
+/*******************************************************************************
+* Function Name:		BL_UART_DeInit
+* Description:			Stop the host DMA reception and its interrupts
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void BL_UART_DeInit(void);
+
+/*******************************************************************************
+*                           Global Variables                                  *
+*******************************************************************************/
+/* Circular buffer filled by the DMA, the head is read from the DMA counter
+ * so every byte is seen as soon as it lands and the tail is moved by the reader */
+static uint8_t BL_UART_Rx_Ring[BL_HOST_RX_RING_SIZE];
+static uint16_t BL_UART_Rx_Tail = 0;
+
+/* The DMA head alone can not tell a full lap from an empty ring, so the bytes are also
+ * counted: the half and complete interrupts add the bytes written since the last event
+ * and the reader adds the bytes it took, more than a ring apart means data was lost */
+static volatile uint32_t BL_UART_Rx_Received = 0;		/* bytes written up to the last rx event */
+static volatile uint16_t BL_UART_Rx_Event_Head = 0;	/* ring position at the last rx event */
+static uint32_t BL_UART_Rx_Consumed = 0;
+static uint32_t BL_UART_Rx_Overruns = 0;
+
+/* Replies queued by the handlers and sent by the tx DMA, the head is moved by the
+ * handlers and the tail by the tx complete interrupt */
+static uint8_t BL_UART_Tx_Queue[BL_HOST_TX_QUEUE_SIZE];
+static volatile uint16_t BL_UART_Tx_Head = 0;
+static volatile uint16_t BL_UART_Tx_Tail = 0;
+static volatile uint16_t BL_UART_Tx_Chunk_Len = 0;	/* bytes given to the DMA, 0 when idle */
+
+const BL_Transport BL_UART_Transport =
+{
+	BL_UART_Init,
+	BL_UART_Sync,
+	BL_UART_Rx_Available,
+	BL_UART_Rx_Read,
+	BL_UART_Send,
+	BL_UART_Flush,
+	BL_UART_Set_Speed,
+	BL_UART_Get_Errors,
+	BL_UART_DeInit,
+	BL_PARSER_BYTE_TIMEOUT,
+	BL_PARSER_FRAME_TIMEOUT
+};
+
+/*******************************************************************************
+*                      Functions Definitions                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		HAL_UART_ErrorCallback
+********************************************************************************/
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if(huart == BL_HOST_COMMUNICATION_UART)
+	{
+		/* The uart lost a byte, the frame it belongs to is broken */
+		if(0 != (huart->ErrorCode & HAL_UART_ERROR_ORE))
+		{
+			BL_UART_Rx_Overruns++;
+		}
+		/* Rx errors and rx DMA errors stop the reception, so start the ring again,
+		 * a tx DMA error leaves the reception running and the ring as it is */
+		if(HAL_UART_STATE_READY == huart->RxState)
+		{
+			BL_UART_Init();
+		}
+		/* A tx DMA error ends the transfer, send the same chunk again */
+		if((HAL_UART_STATE_READY == huart->gState) && (0 != BL_UART_Tx_Chunk_Len))
+		{
+			BL_UART_Tx_Chunk_Len = 0;
+			BL_UART_Tx_Start();
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name:		HAL_UARTEx_RxEventCallback
+********************************************************************************/
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	if(huart == BL_HOST_COMMUNICATION_UART)
+	{
+		/* Size is the ring position of the DMA at the half, complete or idle event,
+		 * two events are never more than half a ring apart */
+		uint16_t Head = Size % BL_HOST_RX_RING_SIZE;
+		BL_UART_Rx_Received += (uint16_t)((Head + BL_HOST_RX_RING_SIZE - BL_UART_Rx_Event_Head) % BL_HOST_RX_RING_SIZE);
+		BL_UART_Rx_Event_Head = Head;
+	}
+}
+
+/*******************************************************************************
+* Function Name:		HAL_UART_TxCpltCallback
+********************************************************************************/
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	if(huart == BL_HOST_COMMUNICATION_UART)
+	{
+		/* The last stop bit of the chunk is out, free it and send what was queued meanwhile */
+		BL_UART_Tx_Tail = (BL_UART_Tx_Tail + BL_UART_Tx_Chunk_Len) % BL_HOST_TX_QUEUE_SIZE;
+		BL_UART_Tx_Chunk_Len = 0;
+		BL_UART_Tx_Start();
+	}
+}
+
+/*******************************************************************************
+*                      Private Functions Definitions                           *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		BL_UART_Init
+********************************************************************************/
+static void BL_UART_Init(void)
+{
+	BL_UART_Rx_Tail = 0;
+	BL_UART_Rx_Received = 0;
+	BL_UART_Rx_Event_Head = 0;
+	BL_UART_Rx_Consumed = 0;
+	/* The DMA keeps receiving in circular mode so no byte is lost while we are
+	 * busy writing the flash or calculating the CRC */
+	HAL_UARTEx_ReceiveToIdle_DMA(BL_HOST_COMMUNICATION_UART,BL_UART_Rx_Ring,BL_HOST_RX_RING_SIZE);
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Sync
+********************************************************************************/
+static uint32_t BL_UART_Sync(void)
+{
+	uint32_t Baud_Rate = 0;
+	
+	/* The uart rx pin is a floating input so the timer can capture it at the same time,
+	 * IC3 takes the falling edges and IC4 the rising edges of TI3 */
+	__HAL_RCC_TIM1_CLK_ENABLE();
+	BL_AUTO_BAUD_TIMER->PSC = 0;
+	BL_AUTO_BAUD_TIMER->ARR = 0xFFFF;
+	BL_AUTO_BAUD_TIMER->CCMR2 = TIM_CCMR2_CC3S_0 | TIM_CCMR2_CC4S_1;
+	BL_AUTO_BAUD_TIMER->CCER = TIM_CCER_CC3P | TIM_CCER_CC3E | TIM_CCER_CC4E;
+	BL_AUTO_BAUD_TIMER->EGR = TIM_EGR_UG;
+	BL_AUTO_BAUD_TIMER->CR1 = TIM_CR1_CEN;
+	
+	while(HAL_OK != BL_UART_Auto_Baud_Measure(&Baud_Rate))
+	{
+		/* Noise or a byte that is not the sync byte, wait the next one */
+	}
+	
+	BL_AUTO_BAUD_TIMER->CR1 = 0;
+	BL_AUTO_BAUD_TIMER->CCER = 0;
+	__HAL_RCC_TIM1_CLK_DISABLE();
+	
+	(BL_HOST_COMMUNICATION_UART)->Init.BaudRate = Baud_Rate;
+	HAL_UART_Init(BL_HOST_COMMUNICATION_UART);
+	return Baud_Rate;
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Auto_Baud_Measure
+********************************************************************************/
+static HAL_StatusTypeDef BL_UART_Auto_Baud_Measure(uint32_t *Baud_Rate)
+{
+	uint16_t Start_Edge = 0;
+	uint16_t Bit_Time = 0;
+	uint16_t Sync_Time = 0;
+	
+	BL_AUTO_BAUD_TIMER->SR = 0;
+	/* Start bit, reading the capture register clears its flag */
+	while(0 == (BL_AUTO_BAUD_TIMER->SR & TIM_SR_CC3IF));
+	Start_Edge = BL_AUTO_BAUD_TIMER->CCR3;
+	/* End of the start bit */
+	while(0 == (BL_AUTO_BAUD_TIMER->SR & TIM_SR_CC4IF));
+	Bit_Time = (uint16_t)(BL_AUTO_BAUD_TIMER->CCR4 - Start_Edge);
+	/* Bit 7 of the sync byte */
+	while(0 == (BL_AUTO_BAUD_TIMER->SR & TIM_SR_CC3IF));
+	Sync_Time = (uint16_t)(BL_AUTO_BAUD_TIMER->CCR3 - Start_Edge);
+	
+	/* Let the stop bit pass before the uart is restarted */
+	while((uint16_t)(BL_AUTO_BAUD_TIMER->CNT - Start_Edge - Sync_Time) < (2 * (Sync_Time / BL_AUTO_BAUD_SYNC_BITS)));
+	
+	/* The start bit must be close to the eighth of the sync time, else it was another byte */
+	if((0 == Sync_Time) || ((BL_AUTO_BAUD_TIMER->SR & TIM_SR_CC3OF) != 0)
+		|| ((Bit_Time * BL_AUTO_BAUD_SYNC_BITS) > (Sync_Time + Sync_Time / 4))
+		|| ((Bit_Time * BL_AUTO_BAUD_SYNC_BITS) < (Sync_Time - Sync_Time / 4)))
+	{
+		return HAL_ERROR;
+	}
+	
+	/* The timer runs from the same clock as USART1 (APB2) */
+	*Baud_Rate = ((HAL_RCC_GetPCLK2Freq() * BL_AUTO_BAUD_SYNC_BITS) + (Sync_Time / 2)) / Sync_Time;
+	if((*Baud_Rate < BL_AUTO_BAUD_MIN) || (*Baud_Rate > BL_AUTO_BAUD_MAX))
+	{
+		return HAL_ERROR;
+	}
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Rx_Available
+********************************************************************************/
+static uint16_t BL_UART_Rx_Available(void)
+{
+	/* The rx event interrupt must not move the count while the head is read */
+	uint32_t Primask = __get_PRIMASK();
+	__disable_irq();
+	
+	/* The DMA counts down the bytes left till the end of the ring */
+	uint16_t Head = (uint16_t)((BL_HOST_RX_RING_SIZE
+		- __HAL_DMA_GET_COUNTER((BL_HOST_COMMUNICATION_UART)->hdmarx)) % BL_HOST_RX_RING_SIZE);
+	uint32_t Received = BL_UART_Rx_Received
+		+ (uint16_t)((Head + BL_HOST_RX_RING_SIZE - BL_UART_Rx_Event_Head) % BL_HOST_RX_RING_SIZE);
+	
+	__set_PRIMASK(Primask);
+	
+	/* A whole ring unread means the DMA wrote over bytes we did not read yet */
+	if((Received - BL_UART_Rx_Consumed) >= BL_HOST_RX_RING_SIZE)
+	{
+		/* Drop all the unread bytes, the parser resyncs on the next frame */
+		BL_UART_Rx_Overruns++;
+		BL_UART_Rx_Consumed = Received;
+		BL_UART_Rx_Tail = Head;
+		return 0;
+	}
+	return (uint16_t)(Received - BL_UART_Rx_Consumed);
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Rx_Read
+********************************************************************************/
+static void BL_UART_Rx_Read(uint8_t *Data, uint16_t Data_Len)
+{
+	uint16_t Counter = 0;
+	
+	for(Counter = 0 ; Counter < Data_Len ; Counter++)
+	{
+		Data[Counter] = BL_UART_Rx_Ring[BL_UART_Rx_Tail];
+		BL_UART_Rx_Tail = (BL_UART_Rx_Tail + 1) % BL_HOST_RX_RING_SIZE;
+	}
+	BL_UART_Rx_Consumed += Data_Len;
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Send
+********************************************************************************/
+static void BL_UART_Send(uint8_t *Data, uint16_t Data_Len)
+{
+	uint16_t Counter = 0;
+	
+	/* Nothing in flight, start from the queue begin so a reply frame stays contiguous */
+	if((0 == BL_UART_Tx_Chunk_Len) && (BL_UART_Tx_Head == BL_UART_Tx_Tail))
+	{
+		BL_UART_Tx_Head = 0;
+		BL_UART_Tx_Tail = 0;
+	}
+	for(Counter = 0 ; Counter < Data_Len ; Counter++)
+	{
+		/* Wait only when the queue is full, the DMA frees it from the interrupt */
+		while(((BL_UART_Tx_Head + 1) % BL_HOST_TX_QUEUE_SIZE) == BL_UART_Tx_Tail)
+		{
+			BL_UART_Tx_Start();
+		}
+		BL_UART_Tx_Queue[BL_UART_Tx_Head] = Data[Counter];
+		BL_UART_Tx_Head = (BL_UART_Tx_Head + 1) % BL_HOST_TX_QUEUE_SIZE;
+	}
+	BL_UART_Tx_Start();
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Tx_Start
+********************************************************************************/
+static void BL_UART_Tx_Start(void)
+{
+	/* The tx complete interrupt must not start the DMA at the same time */
+	uint32_t Primask = __get_PRIMASK();
+	__disable_irq();
+	
+	uint16_t Head = BL_UART_Tx_Head;
+	uint16_t Tail = BL_UART_Tx_Tail;
+	if((0 == BL_UART_Tx_Chunk_Len) && (Head != Tail))
+	{
+		/* The DMA needs contiguous bytes, the part after the queue end goes next time */
+		BL_UART_Tx_Chunk_Len = (Head > Tail) ? (Head - Tail) : (BL_HOST_TX_QUEUE_SIZE - Tail);
+		if(HAL_OK != HAL_UART_Transmit_DMA(BL_HOST_COMMUNICATION_UART,&BL_UART_Tx_Queue[Tail],BL_UART_Tx_Chunk_Len))
+		{
+			BL_UART_Tx_Chunk_Len = 0;
+		}
+	}
+	
+	__set_PRIMASK(Primask);
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Flush
+********************************************************************************/
+static void BL_UART_Flush(void)
+{
+	/* The tail moves after the transmission complete flag of the last byte, the DMA is
+	 * started again here in case the interrupt found the uart locked by the rx side */
+	while(BL_UART_Tx_Head != BL_UART_Tx_Tail)
+	{
+		BL_UART_Tx_Start();
+	}
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Set_Speed
+********************************************************************************/
+static void BL_UART_Set_Speed(uint32_t Speed)
+{
+	/* The queued replies belong to the old speed */
+	BL_UART_Flush();
+	HAL_UART_AbortReceive(BL_HOST_COMMUNICATION_UART);
+	(BL_HOST_COMMUNICATION_UART)->Init.BaudRate = Speed;
+	HAL_UART_Init(BL_HOST_COMMUNICATION_UART);
+	/* The unread bytes were sent with the old speed so start with an empty ring */
+	BL_UART_Init();
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_Get_Errors
+********************************************************************************/
+static uint32_t BL_UART_Get_Errors(void)
+{
+	return BL_UART_Rx_Overruns;
+}
+
+/*******************************************************************************
+* Function Name:		BL_UART_DeInit
+********************************************************************************/
+static void BL_UART_DeInit(void)
+{
+	HAL_UART_DeInit(BL_HOST_COMMUNICATION_UART);
+}
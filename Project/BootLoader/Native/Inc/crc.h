@@ -0,0 +1,16 @@
+/******************************************************************************
+*  File name:		crc.h
+*  Date:				Oct 17, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* Native build : takes the place of Core/Inc/crc.h */
+#ifndef	__CRC_H__
+#define __CRC_H__
+
+#include "main.h"
+
+extern CRC_HandleTypeDef hcrc;
+
+#endif /* __CRC_H__ */
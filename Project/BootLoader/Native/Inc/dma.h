@@ -0,0 +1,16 @@
+/******************************************************************************
+*  File name:		dma.h
+*  Date:				Oct 17, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* Native build : takes the place of Core/Inc/dma.h, the channel feeds the software CRC engine */
+#ifndef	__DMA_H__
+#define __DMA_H__
+
+#include "main.h"
+
+extern DMA_HandleTypeDef hdma_memtomem_dma1_channel1;
+
+#endif /* __DMA_H__ */
@@ -0,0 +1,14 @@
+/******************************************************************************
+*  File name:		main.h
+*  Date:				Oct 17, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* Native build : takes the place of Core/Inc/main.h */
+#ifndef	__MAIN_H
+#define __MAIN_H
+
+#include "native_hal.h"
+
+#endif /* __MAIN_H */
@@ -0,0 +1,253 @@
+/******************************************************************************
+*  File name:		native_hal.h
+*  Date:				Oct 17, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* Stand-ins for the part of the HAL and CMSIS the command core uses, so bootloader.c
+ * builds unmodified on Linux : the flash is a file mapped at 0x08000000, the CRC
+ * engine and its DMA run in software and the host link is BL_PTY_Transport.
+ * The Makefile forces this header in front of every file (-include) */
+#ifndef	_NATIVE_HAL_H_
+#define _NATIVE_HAL_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/*******************************************************************************
+*                         Types Declaration                                   *
+*******************************************************************************/
+typedef enum
+{
+	HAL_OK       = 0x00U,
+	HAL_ERROR    = 0x01U,
+	HAL_BUSY     = 0x02U,
+	HAL_TIMEOUT  = 0x03U
+}HAL_StatusTypeDef;
+
+typedef struct
+{
+	uint32_t Instance;
+}UART_HandleTypeDef;
+
+typedef struct
+{
+	volatile uint32_t DR;
+	volatile uint8_t IDR;
+	volatile uint32_t CR;
+}CRC_TypeDef;
+
+typedef struct
+{
+	CRC_TypeDef *Instance;
+}CRC_HandleTypeDef;
+
+typedef struct
+{
+	volatile uint32_t CCR;
+	volatile uint32_t CNDTR;
+	volatile uint32_t CPAR;
+	volatile uint32_t CMAR;
+}DMA_Channel_TypeDef;
+
+typedef struct
+{
+	uint32_t Direction;
+	uint32_t PeriphInc;
+	uint32_t MemInc;
+	uint32_t PeriphDataAlignment;
+	uint32_t MemDataAlignment;
+	uint32_t Mode;
+	uint32_t Priority;
+}DMA_InitTypeDef;
+
+typedef enum
+{
+	HAL_DMA_STATE_RESET    = 0x00U,
+	HAL_DMA_STATE_READY    = 0x01U,
+	HAL_DMA_STATE_BUSY     = 0x02U,
+	HAL_DMA_STATE_TIMEOUT  = 0x03U
+}HAL_DMA_StateTypeDef;
+
+typedef struct
+{
+	DMA_Channel_TypeDef *Instance;
+	DMA_InitTypeDef Init;
+	HAL_DMA_StateTypeDef State;
+	uint32_t ErrorCode;
+}DMA_HandleTypeDef;
+
+typedef struct
+{
+	uint32_t TypeErase;
+	uint32_t Banks;
+	uint32_t PageAddress;
+	uint32_t NbPages;
+}FLASH_EraseInitTypeDef;
+
+typedef struct
+{
+	uint32_t OptionType;
+	uint32_t WRPState;
+	uint32_t WRPPage;
+	uint32_t Banks;
+	uint8_t RDPLevel;
+	uint8_t USERConfig;
+	uint32_t DATAAddress;
+	uint8_t DATAData;
+}FLASH_OBProgramInitTypeDef;
+
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+}DWT_Type;
+
+typedef struct
+{
+	volatile uint32_t DEMCR;
+}CoreDebug_Type;
+
+typedef struct
+{
+	volatile uint32_t IDCODE;
+}DBGMCU_TypeDef;
+
+/*******************************************************************************
+*                        		Definitions                                   		 *
+*******************************************************************************/
+#define HAL_MAX_DELAY												0xFFFFFFFFU
+
+#define FLASH_TYPEPROGRAM_HALFWORD					0x01U
+#define FLASH_TYPEERASE_PAGES								0x00U
+#define FLASH_TYPEERASE_MASSERASE						0x02U
+#define FLASH_BANK_1												0x01U
+#define OPTIONBYTE_RDP											0x02U
+#define OB_RDP_LEVEL_0											((uint8_t)0xA5)
+#define OB_RDP_LEVEL_1											((uint8_t)0x00)
+
+#define DMA_CCR_EN													0x00000001U
+#define DMA_CCR_PSIZE												0x00000300U
+#define DMA_PDATAALIGN_BYTE									0x00000000U
+#define DMA_PDATAALIGN_HALFWORD							0x00000100U
+#define DMA_PDATAALIGN_WORD									0x00000200U
+#define HAL_DMA_ERROR_NONE									0x00000000U
+#define __HAL_DMA_DISABLE(__HANDLE__)				((__HANDLE__)->Instance->CCR &= ~DMA_CCR_EN)
+
+#define MODIFY_REG(REG, CLEARMASK, SETMASK)	((REG) = (((REG) & (~(CLEARMASK))) | (SETMASK)))
+
+#define CoreDebug_DEMCR_TRCENA_Msk					(1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk							(1UL << 0)
+#define DWT																	(&Native_DWT)
+#define CoreDebug														(&Native_CoreDebug)
+#define DBGMCU															(&Native_DBGMCU)
+
+/* The software engine takes the place of CRC->DR (see BL_CRC_WRITE in bootloader.h) */
+#define BL_CRC_WRITE(Value)									Native_CRC_Write(Value)
+#define BL_CRC_READ()												Native_CRC_Read()
+#define BL_CRC_RESET()											Native_CRC_Reset()
+
+#define NATIVE_FLASH_START									0x08000000U
+#define NATIVE_FLASH_SIZE										(64U*1024U)
+#define NATIVE_FLASH_PAGE_SIZE								1024U
+#define NATIVE_DBGMCU_IDCODE								0x20036410U	/* STM32F103 medium density */
+#define NATIVE_CORE_CLOCK										72000000U
+#define NATIVE_CRC_POLYNOMIAL								0x04C11DB7U
+#define NATIVE_CRC_RESET_VALUE							0xFFFFFFFFU
+
+/*******************************************************************************
+*                           Global Variables                                  *
+*******************************************************************************/
+extern DWT_Type Native_DWT;
+extern CoreDebug_Type Native_CoreDebug;
+extern DBGMCU_TypeDef Native_DBGMCU;
+extern uint32_t SystemCoreClock;
+
+/*******************************************************************************
+*                      Functions Prototypes                                    *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		Native_Flash_Map
+* Description:			Map the flash file at the flash address of the MCU, a new file
+*										is created erased
+* Parameters (in):  Path of the flash file
+* Parameters (out): None
+* Return value:     Void, the process ends if the flash can't be mapped
+********************************************************************************/
+void Native_Flash_Map(const char *Path);
+
+/*******************************************************************************
+* Function Name:		Native_CRC_Write
+* Description:			Feed one word to the software CRC engine, MSB first as the MCU engine
+* Parameters (in):  Word
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+void Native_CRC_Write(uint32_t Value);
+
+/*******************************************************************************
+* Function Name:		Native_CRC_Read
+* Description:			Get the CRC of the words fed since the last reset
+* Parameters (in):  None
+* Parameters (out): CRC value
+* Return value:     uint32_t
+********************************************************************************/
+uint32_t Native_CRC_Read(void);
+
+/*******************************************************************************
+* Function Name:		Native_CRC_Reset
+* Description:			Reset the software CRC engine to 0xFFFFFFFF
+* Parameters (in):  None
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+void Native_CRC_Reset(void);
+
+/* Same prototypes as the STM32F1 HAL, only what the command core calls */
+uint32_t HAL_GetTick(void);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+HAL_StatusTypeDef HAL_FLASH_OB_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_OB_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_OB_Launch(void);
+HAL_StatusTypeDef HAL_FLASHEx_OBProgram(FLASH_OBProgramInitTypeDef *pOBInit);
+void HAL_FLASHEx_OBGetConfig(FLASH_OBProgramInitTypeDef *pOBInit);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma);
+uint32_t HAL_DMA_GetError(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_RCC_DeInit(void);
+
+/*******************************************************************************
+*                      CMSIS Intrinsics                                        *
+*******************************************************************************/
+/* Nothing to switch to, the jump that follows ends the process (see native_main.c) */
+static inline void __set_MSP(uint32_t topOfMainStack)
+{
+	(void)topOfMainStack;
+}
+
+static inline uint32_t __UNALIGNED_UINT32_READ(const void *Address)
+{
+	uint32_t Value;
+	memcpy(&Value,Address,sizeof(Value));
+	return Value;
+}
+
+static inline uint32_t __REV(uint32_t Value)
+{
+	return __builtin_bswap32(Value);
+}
+
+static inline uint32_t __ROR(uint32_t Value, uint32_t Shift)
+{
+	Shift %= 32U;
+	return (0U == Shift) ? Value : ((Value >> Shift) | (Value << (32U - Shift)));
+}
+
+#endif /* _NATIVE_HAL_H_ */
@@ -0,0 +1,17 @@
+/******************************************************************************
+*  File name:		usart.h
+*  Date:				Oct 17, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* Native build : takes the place of Core/Inc/usart.h, huart2 prints to stderr */
+#ifndef	__USART_H__
+#define __USART_H__
+
+#include "main.h"
+
+extern UART_HandleTypeDef huart1;
+extern UART_HandleTypeDef huart2;
+
+#endif /* __USART_H__ */
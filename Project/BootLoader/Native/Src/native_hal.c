@@ -0,0 +1,344 @@
+/******************************************************************************
+*  File name:		native_hal.c
+*  Date:				Oct 17, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/*******************************************************************************
+*                        		Inclusions                                   		   *
+*******************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "usart.h"
+#include "crc.h"
+#include "dma.h"
+
+/*******************************************************************************
+*                           Global Variables                                  *
+*******************************************************************************/
+UART_HandleTypeDef huart1 = {1};
+UART_HandleTypeDef huart2 = {2};
+
+static CRC_TypeDef Native_CRC_Registers;
+CRC_HandleTypeDef hcrc = {&Native_CRC_Registers};
+static uint32_t Native_CRC_Value = NATIVE_CRC_RESET_VALUE;
+
+static DMA_Channel_TypeDef Native_DMA1_Channel1;
+DMA_HandleTypeDef hdma_memtomem_dma1_channel1 = {&Native_DMA1_Channel1,{0},HAL_DMA_STATE_READY,HAL_DMA_ERROR_NONE};
+
+DWT_Type Native_DWT;
+CoreDebug_Type Native_CoreDebug;
+DBGMCU_TypeDef Native_DBGMCU = {NATIVE_DBGMCU_IDCODE};
+uint32_t SystemCoreClock = NATIVE_CORE_CLOCK;
+
+/* Locked after reset like the flash controller, a write without unlock fails as on the MCU */
+static uint8_t Native_Flash_Locked = 1;
+static uint8_t Native_OB_Locked = 1;
+static uint8_t Native_RDP_Level = OB_RDP_LEVEL_0;
+
+/*******************************************************************************
+*                      Functions Definitions                                   *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		Native_Flash_Map
+********************************************************************************/
+void Native_Flash_Map(const char *Path)
+{
+	int Flash_File = open(Path,O_RDWR | O_CREAT,0644);
+	off_t File_Size = 0;
+	void *Flash = MAP_FAILED;
+
+	if(Flash_File < 0)
+	{
+		perror(Path);
+		exit(EXIT_FAILURE);
+	}
+	File_Size = lseek(Flash_File,0,SEEK_END);
+	if(File_Size < (off_t)NATIVE_FLASH_SIZE)
+	{
+		/* A new flash comes erased */
+		uint8_t Erased[NATIVE_FLASH_PAGE_SIZE];
+		memset(Erased,0xFF,sizeof(Erased));
+		while(File_Size < (off_t)NATIVE_FLASH_SIZE)
+		{
+			if(sizeof(Erased) != write(Flash_File,Erased,sizeof(Erased)))
+			{
+				perror(Path);
+				exit(EXIT_FAILURE);
+			}
+			File_Size += sizeof(Erased);
+		}
+	}
+	/* The core reads the flash through its 32 bit addresses, it must sit where it does on the MCU */
+	Flash = mmap((void *)(uintptr_t)NATIVE_FLASH_START,NATIVE_FLASH_SIZE,PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_FIXED_NOREPLACE,Flash_File,0);
+	if((MAP_FAILED == Flash) || ((void *)(uintptr_t)NATIVE_FLASH_START != Flash))
+	{
+		perror("BL flash map");
+		exit(EXIT_FAILURE);
+	}
+	close(Flash_File);
+}
+
+/*******************************************************************************
+* Function Name:		Native_CRC_Write
+********************************************************************************/
+void Native_CRC_Write(uint32_t Value)
+{
+	uint8_t Bit = 0;
+
+	Native_CRC_Value ^= Value;
+	for(Bit = 0 ; Bit < 32 ; Bit++)
+	{
+		if(Native_CRC_Value & 0x80000000U)
+		{
+			Native_CRC_Value = (Native_CRC_Value << 1) ^ NATIVE_CRC_POLYNOMIAL;
+		}
+		else
+		{
+			Native_CRC_Value <<= 1;
+		}
+	}
+}
+
+/*******************************************************************************
+* Function Name:		Native_CRC_Read
+********************************************************************************/
+uint32_t Native_CRC_Read(void)
+{
+	return Native_CRC_Value;
+}
+
+/*******************************************************************************
+* Function Name:		Native_CRC_Reset
+********************************************************************************/
+void Native_CRC_Reset(void)
+{
+	Native_CRC_Value = NATIVE_CRC_RESET_VALUE;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_GetTick
+********************************************************************************/
+uint32_t HAL_GetTick(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC,&Now);
+	return (uint32_t)((Now.tv_sec * 1000) + (Now.tv_nsec / 1000000));
+}
+
+/*******************************************************************************
+* Function Name:		HAL_UART_Transmit
+********************************************************************************/
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+	/* Only the debug messages come here, the host link is the pseudo-terminal */
+	if(&huart2 == huart)
+	{
+		fwrite(pData,1,Size,stderr);
+	}
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASH_Unlock
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	Native_Flash_Locked = 0;
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASH_Lock
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	Native_Flash_Locked = 1;
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASH_Program
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	volatile uint16_t *Half_Word = (volatile uint16_t *)(uintptr_t)Address;
+
+	if((Native_Flash_Locked) || (FLASH_TYPEPROGRAM_HALFWORD != TypeProgram) || (0 != (Address % 2))
+		|| (Address < NATIVE_FLASH_START) || (Address >= (NATIVE_FLASH_START + NATIVE_FLASH_SIZE)))
+	{
+		return HAL_ERROR;
+	}
+	/* Like the F1 flash a half word is programmed once after the erase, only 0x0000 may go over it */
+	if((0xFFFF != *Half_Word) && (0 != (uint16_t)Data))
+	{
+		return HAL_ERROR;
+	}
+	*Half_Word = (uint16_t)Data;
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASHEx_Erase
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+	uint32_t Erase_Address = NATIVE_FLASH_START;
+	uint32_t Erase_Size = NATIVE_FLASH_SIZE;
+
+	*PageError = 0xFFFFFFFFU;
+	if(Native_Flash_Locked)
+	{
+		return HAL_ERROR;
+	}
+	if(FLASH_TYPEERASE_PAGES == pEraseInit->TypeErase)
+	{
+		Erase_Address = pEraseInit->PageAddress;
+		Erase_Size = pEraseInit->NbPages * NATIVE_FLASH_PAGE_SIZE;
+		if((Erase_Address < NATIVE_FLASH_START) || (0 != (Erase_Address % NATIVE_FLASH_PAGE_SIZE))
+			|| (Erase_Size > ((NATIVE_FLASH_START + NATIVE_FLASH_SIZE) - Erase_Address)))
+		{
+			*PageError = Erase_Address;
+			return HAL_ERROR;
+		}
+	}
+	memset((void *)(uintptr_t)Erase_Address,0xFF,Erase_Size);
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASH_OB_Unlock
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASH_OB_Unlock(void)
+{
+	Native_OB_Locked = 0;
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASH_OB_Lock
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASH_OB_Lock(void)
+{
+	Native_OB_Locked = 1;
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASH_OB_Launch
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASH_OB_Launch(void)
+{
+	/* The MCU resets here to load the option bytes, the native build keeps running */
+	fprintf(stderr,"Option bytes loaded, RDP 0x%02X\n",Native_RDP_Level);
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASHEx_OBProgram
+********************************************************************************/
+HAL_StatusTypeDef HAL_FLASHEx_OBProgram(FLASH_OBProgramInitTypeDef *pOBInit)
+{
+	if((Native_Flash_Locked) || (Native_OB_Locked))
+	{
+		return HAL_ERROR;
+	}
+	if(OPTIONBYTE_RDP & pOBInit->OptionType)
+	{
+		Native_RDP_Level = pOBInit->RDPLevel;
+	}
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_FLASHEx_OBGetConfig
+********************************************************************************/
+void HAL_FLASHEx_OBGetConfig(FLASH_OBProgramInitTypeDef *pOBInit)
+{
+	memset(pOBInit,0,sizeof(FLASH_OBProgramInitTypeDef));
+	pOBInit->OptionType = OPTIONBYTE_RDP;
+	pOBInit->RDPLevel = Native_RDP_Level;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_DMA_Start_IT
+********************************************************************************/
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	uint32_t Unit_Size = 1;
+	uint32_t Value = 0;
+
+	/* The only channel is flash to CRC->DR, it runs at once and the transfer is complete on return */
+	if((HAL_DMA_STATE_READY != hdma->State) || (DstAddress != (uint32_t)(uintptr_t)&hcrc.Instance->DR))
+	{
+		return HAL_ERROR;
+	}
+	switch(hdma->Instance->CCR & DMA_CCR_PSIZE)
+	{
+		case DMA_PDATAALIGN_HALFWORD:
+			Unit_Size = 2;
+			break;
+
+		case DMA_PDATAALIGN_WORD:
+			Unit_Size = 4;
+			break;
+
+		default:
+			break;
+	}
+	for( ; DataLength > 0 ; DataLength--)
+	{
+		/* A byte or a half word goes to the word register zero extended */
+		Value = 0;
+		memcpy(&Value,(const void *)(uintptr_t)SrcAddress,Unit_Size);
+		Native_CRC_Write(Value);
+		SrcAddress += Unit_Size;
+	}
+	hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_DMA_Abort
+********************************************************************************/
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+	hdma->State = HAL_DMA_STATE_READY;
+	return HAL_OK;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_DMA_GetState
+********************************************************************************/
+HAL_DMA_StateTypeDef HAL_DMA_GetState(DMA_HandleTypeDef *hdma)
+{
+	return hdma->State;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_DMA_GetError
+********************************************************************************/
+uint32_t HAL_DMA_GetError(DMA_HandleTypeDef *hdma)
+{
+	return hdma->ErrorCode;
+}
+
+/*******************************************************************************
+* Function Name:		HAL_RCC_DeInit
+********************************************************************************/
+HAL_StatusTypeDef HAL_RCC_DeInit(void)
+{
+	return HAL_OK;
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+*  File name:		native_main.c
+*  Date:				Oct 17, 2026
+*  Author:			Ahmed Tarek
+*  Version:         1.0
+*******************************************************************************/
+
+/* Native build of the command core : same start as Core/Src/main.c with the flash
+ * in a file, the host script connects to the pseudo-terminal the BL prints.
+ * Usage : ./bootloader [flash file, flash.bin by default] */
+
+/*******************************************************************************
+*                        		Inclusions                                   		   *
+*******************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "main.h"
+#include "bootloader.h"
+
+/*******************************************************************************
+*                        		Definitions                                   		 *
+*******************************************************************************/
+#define NATIVE_DEFAULT_FLASH_FILE						"flash.bin"
+
+/*******************************************************************************
+*                      Private Functions                               		     *
+*******************************************************************************/
+/*******************************************************************************
+* Function Name:		Native_Jump_Handler
+* Description:			A jump of the BL to the application or to a host address calls
+*										code that can't run here (the flash is not executable), end the
+*										process there and let any other fault crash as usual
+* Parameters (in):  Signal number, its information and context
+* Parameters (out): None
+* Return value:     Void
+********************************************************************************/
+static void Native_Jump_Handler(int Signal, siginfo_t *Info, void *Context);
+
+/*******************************************************************************
+*                      Private Functions Definitions                           *
+*******************************************************************************/
+
+/*******************************************************************************
+* Function Name:		Native_Jump_Handler
+********************************************************************************/
+static void Native_Jump_Handler(int Signal, siginfo_t *Info, void *Context)
+{
+	static const char Jump_Message[] = "BL left for the application, the native build stops here\n";
+	ucontext_t *Fault_Context = (ucontext_t *)Context;
+	uintptr_t Fault_PC = 0;
+
+	#if defined(__x86_64__)
+	Fault_PC = (uintptr_t)Fault_Context->uc_mcontext.gregs[REG_RIP];
+	#elif defined(__aarch64__)
+	Fault_PC = (uintptr_t)Fault_Context->uc_mcontext.pc;
+	#endif
+	/* The fetch of the first instruction faulted : the BL called into the flash or an address of the host */
+	if((uintptr_t)Info->si_addr == Fault_PC)
+	{
+		/* Only async signal safe calls here */
+		if(write(STDERR_FILENO,Jump_Message,sizeof(Jump_Message) - 1)) {}
+		_exit(0);
+	}
+	signal(Signal,SIG_DFL);
+}
+
+/*******************************************************************************
+* Function Name:		main
+********************************************************************************/
+int main(int argc, char *argv[])
+{
+	struct sigaction Jump_Action = {0};
+
+	Native_Flash_Map((argc > 1) ? argv[1] : NATIVE_DEFAULT_FLASH_FILE);
+	Jump_Action.sa_sigaction = Native_Jump_Handler;
+	Jump_Action.sa_flags = SA_SIGINFO;
+	sigaction(SIGSEGV,&Jump_Action,NULL);
+
+	BL_Print_Message("BL START\r\n");
+	BL_Auto_Baud_Detect();
+	BL_Init();
+	while(1)
+	{
+		BL_UART_Fetch_Host_Command();
+	}
+	return 0;
+}